@@ -139,6 +139,9 @@ struct Core::Private
 
     bool last_autosave_request{false};
     bool was_load_save{false};
+
+    std::mutex suspend_stats_mutex;
+    std::map<std::pair<std::string, bool>, SuspendStats> suspend_stats;
 };
 
 struct CommandDepthCounter
@@ -701,6 +704,7 @@ command_result Core::runCommand(color_ostream &con, const std::string &first_, v
             first.c_str(), CommandDepthCounter::MAX_DEPTH);
         return CR_FAILURE;
     }
+    CoreSuspendCaller caller(first_.c_str());
 
     command_result res;
     if (!first.empty())
@@ -1544,7 +1548,10 @@ Core::Core() :
     CoreSuspendMutex{},
     CoreWakeup{},
     ownerThread{},
-    toolCount{0}
+    toolCount{0},
+    SharedSuspendMutex{},
+    SharedSuspendDone{},
+    sharedCount{0}
 {
     // init the console. This must be always the first step!
     plug_mgr = 0;
@@ -1796,6 +1803,16 @@ bool Core::Init()
 
     loadScriptPaths(con);
 
+    // id -> index tables behind find() for the largest instance vectors
+    set_dense_id_update_check([]() -> bool { return Core::getInstance().isSuspended(); });
+    if (df::global::world)
+    {
+        register_dense_id_vector(&df::global::world->units.all);
+        register_dense_id_vector(&df::global::world->items.all);
+        register_dense_id_vector(&df::global::world->history.figures);
+        register_dense_id_vector(&df::global::world->buildings.all);
+    }
+
     // initialize common lua context
     if (!Lua::Core::Init(con))
     {
@@ -1969,6 +1986,119 @@ void *Core::GetData( std::string key )
     }
 }
 
+// Shared suspend depth of this thread. Nested shared suspenders must not wait
+// for CoreSuspendMutex, as an exclusive suspender may hold it while waiting
+// for the outer one.
+static thread_local size_t shared_suspend_depth = 0;
+// Caller name for suspend statistics, set by CoreSuspendCaller.
+static thread_local const char *suspend_caller = NULL;
+static const size_t SUSPEND_HISTOGRAM_BUCKETS = 24;
+
+size_t Core::lockShared()
+{
+    toolCount.fetch_add(1, std::memory_order_relaxed);
+    if (shared_suspend_depth > 0)
+    {
+        // DF is already parked for the outer shared suspender.
+        std::lock_guard<std::mutex> guard(SharedSuspendMutex);
+        sharedCount++;
+        return shared_suspend_depth++;
+    }
+    // Getting CoreSuspendMutex means DF is parked and no exclusive suspender
+    // is running. Raising toolCount keeps DF parked after it is released.
+    std::lock_guard<std::recursive_mutex> lock(CoreSuspendMutex);
+    std::lock_guard<std::mutex> guard(SharedSuspendMutex);
+    sharedCount++;
+    return shared_suspend_depth++;
+}
+
+void Core::unlockShared()
+{
+    {
+        std::lock_guard<std::mutex> guard(SharedSuspendMutex);
+        sharedCount--;
+        shared_suspend_depth--;
+    }
+    SharedSuspendDone.notify_all();
+    if (toolCount.fetch_add(-1, std::memory_order_relaxed) == 1)
+        CoreWakeup.notify_one();
+}
+
+void Core::waitForSharedSuspenders()
+{
+    std::unique_lock<std::mutex> lock(SharedSuspendMutex);
+    SharedSuspendDone.wait(lock, [this]() -> bool {
+        return sharedCount == 0;
+    });
+}
+
+bool Core::holdsSharedSuspend()
+{
+    return shared_suspend_depth > 0;
+}
+
+static size_t suspend_histogram_bucket(uint64_t us)
+{
+    size_t bucket = 0;
+    while (us && bucket + 1 < SUSPEND_HISTOGRAM_BUCKETS)
+    {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void Core::recordSuspend(bool shared, std::chrono::steady_clock::duration wait,
+                         std::chrono::steady_clock::duration hold)
+{
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    uint64_t wait_us = duration_cast<microseconds>(wait).count();
+    uint64_t hold_us = duration_cast<microseconds>(hold).count();
+    std::string caller = suspend_caller ? suspend_caller : "";
+
+    std::lock_guard<std::mutex> lock(d->suspend_stats_mutex);
+    SuspendStats &stats = d->suspend_stats[std::make_pair(caller, shared)];
+    if (stats.count == 0)
+    {
+        stats.caller = caller;
+        stats.shared = shared;
+        stats.wait_histogram.resize(SUSPEND_HISTOGRAM_BUCKETS);
+        stats.hold_histogram.resize(SUSPEND_HISTOGRAM_BUCKETS);
+    }
+    stats.count++;
+    stats.wait_us += wait_us;
+    stats.hold_us += hold_us;
+    stats.wait_histogram[suspend_histogram_bucket(wait_us)]++;
+    stats.hold_histogram[suspend_histogram_bucket(hold_us)]++;
+}
+
+std::vector<SuspendStats> Core::getSuspendStats()
+{
+    std::vector<SuspendStats> rv;
+    std::lock_guard<std::mutex> lock(d->suspend_stats_mutex);
+    for (auto &entry : d->suspend_stats)
+        rv.push_back(entry.second);
+    return rv;
+}
+
+void Core::resetSuspendStats()
+{
+    std::lock_guard<std::mutex> lock(d->suspend_stats_mutex);
+    d->suspend_stats.clear();
+}
+
+CoreSuspendCaller::CoreSuspendCaller(const char *name)
+    : prev(suspend_caller)
+{
+    suspend_caller = name;
+}
+
+CoreSuspendCaller::~CoreSuspendCaller()
+{
+    suspend_caller = prev;
+}
+
 bool Core::isSuspended(void)
 {
     return ownerThread.load() == std::this_thread::get_id();
@@ -2115,6 +2245,8 @@ int Core::Update()
 
 extern bool buildings_do_onupdate;
 void buildings_onStateChange(color_ostream &out, state_change_event event);
+void mapcache_onStateChange(color_ostream &out, state_change_event event);
+void items_onStateChange(color_ostream &out, state_change_event event);
 void buildings_onUpdate(color_ostream &out);
 
 static int buildings_timer = 0;
@@ -2315,6 +2447,10 @@ void Core::onStateChange(color_ostream &out, state_change_event event)
 
     buildings_onStateChange(out, event);
 
+    mapcache_onStateChange(out, event);
+
+    items_onStateChange(out, event);
+
     plug_mgr->OnStateChange(out, event);
 
     Lua::Core::onStateChange(out, event);
@@ -2514,6 +2650,26 @@ int Core::DFH_SDL_Event(SDL::Event* ev)
     // do stuff with the events...
 }
 
+static int64_t hotkey_table_key(int sym, int modifiers)
+{
+    return (int64_t(sym) << 8) | uint8_t(modifiers);
+}
+
+// Must be called with HotkeyMutex held.
+void Core::compileKeyBindings()
+{
+    std::shared_ptr<HotkeyTable> table(new HotkeyTable());
+    for (auto it = key_bindings.begin(); it != key_bindings.end(); ++it)
+    {
+        const std::vector<KeyBinding> &bindings = it->second;
+        for (int i = bindings.size()-1; i >= 0; --i)
+            (*table)[hotkey_table_key(it->first, bindings[i].modifiers)].push_back(bindings[i]);
+    }
+
+    std::lock_guard<std::mutex> lock(hotkey_table_mutex);
+    hotkey_table = table;
+}
+
 bool Core::SelectHotkey(int sym, int modifiers)
 {
     // Find the topmost viewscreen
@@ -2527,39 +2683,57 @@ bool Core::SelectHotkey(int sym, int modifiers)
     if (sym == SDL::K_KP_ENTER)
         sym = SDL::K_RETURN;
 
-    std::string cmd;
-
+    std::shared_ptr<const HotkeyTable> table;
     {
-        std::lock_guard<std::mutex> lock(HotkeyMutex);
+        std::lock_guard<std::mutex> lock(hotkey_table_mutex);
+        table = hotkey_table;
+    }
 
-        // Check the internal keybindings
-        std::vector<KeyBinding> &bindings = key_bindings[sym];
-        for (int i = bindings.size()-1; i >= 0; --i) {
-            if (bindings[i].modifiers != modifiers)
-                continue;
-            if (!bindings[i].focus.empty() &&
-                !prefix_matches(bindings[i].focus, Gui::getFocusString(screen)))
-                continue;
-            if (!plug_mgr->CanInvokeHotkey(bindings[i].command[0], screen))
+    std::string cmd;
+
+    // Check the internal keybindings
+    const std::vector<KeyBinding> *bindings = NULL;
+    if (table) {
+        auto found = table->find(hotkey_table_key(sym, modifiers));
+        if (found != table->end())
+            bindings = &found->second;
+    }
+    if (bindings) {
+        // only compute the focus string if a binding needs it
+        std::string focus;
+        bool have_focus = false;
+        for (auto it = bindings->begin(); it != bindings->end(); ++it) {
+            if (!it->focus.empty()) {
+                if (!have_focus) {
+                    focus = Gui::getFocusString(screen);
+                    have_focus = true;
+                }
+                // The focus prefixes need no compiling: AddKeyBinding already
+                // splits '|' alternatives into separate bindings, so this is
+                // one memcmp and a '/' boundary check per candidate.
+                if (!prefix_matches(it->focus, focus))
+                    continue;
+            }
+            if (!plug_mgr->CanInvokeHotkey(it->command[0], screen))
                 continue;
-            cmd = bindings[i].cmdline;
+            cmd = it->cmdline;
             break;
         }
+    }
 
-        if (cmd.empty()) {
-            // Check the hotkey keybindings
-            int idx = sym - SDL::K_F1;
-            if(idx >= 0 && idx < 8)
-            {
-                if (modifiers & 1)
-                    idx += 8;
+    if (cmd.empty()) {
+        // Check the hotkey keybindings
+        int idx = sym - SDL::K_F1;
+        if(idx >= 0 && idx < 8)
+        {
+            if (modifiers & 1)
+                idx += 8;
 
-                if (strict_virtual_cast<df::viewscreen_dwarfmodest>(screen) &&
-                    df::global::ui->main.mode != ui_sidebar_mode::Hotkeys &&
-                    df::global::ui->main.hotkeys[idx].cmd == df::ui_hotkey::T_cmd::None)
-                {
-                    cmd = df::global::ui->main.hotkeys[idx].name;
-                }
+            if (strict_virtual_cast<df::viewscreen_dwarfmodest>(screen) &&
+                df::global::ui->main.mode != ui_sidebar_mode::Hotkeys &&
+                df::global::ui->main.hotkeys[idx].cmd == df::ui_hotkey::T_cmd::None)
+            {
+                cmd = df::global::ui->main.hotkeys[idx].name;
             }
         }
     }
@@ -2631,12 +2805,17 @@ bool Core::ClearKeyBindings(std::string keyspec)
 
     std::lock_guard<std::mutex> lock(HotkeyMutex);
 
-    std::vector<KeyBinding> &bindings = key_bindings[sym];
+    auto found = key_bindings.find(sym);
+    if (found == key_bindings.end())
+        return true;
+
+    std::vector<KeyBinding> &bindings = found->second;
     for (int i = bindings.size()-1; i >= 0; --i) {
         if (bindings[i].modifiers == mod && prefix_matches(focus, bindings[i].focus))
             bindings.erase(bindings.begin()+i);
     }
 
+    compileKeyBindings();
     return true;
 }
 
@@ -2681,6 +2860,7 @@ bool Core::AddKeyBinding(std::string keyspec, std::string cmdline)
 
     binding.cmdline = cmdline;
     bindings.push_back(binding);
+    compileKeyBindings();
     return true;
 }
 
@@ -2694,7 +2874,11 @@ std::vector<std::string> Core::ListKeyBindings(std::string keyspec)
 
     std::lock_guard<std::mutex> lock(HotkeyMutex);
 
-    std::vector<KeyBinding> &bindings = key_bindings[sym];
+    auto found = key_bindings.find(sym);
+    if (found == key_bindings.end())
+        return rv;
+
+    std::vector<KeyBinding> &bindings = found->second;
     for (int i = bindings.size()-1; i >= 0; --i) {
         if (focus.size() && focus != bindings[i].focus)
             continue;
@@ -24,11 +24,18 @@ distribution.
 
 #include "Internal.h"
 
+#include <cctype>
+#include <algorithm>
 #include <cstring>
 #include <string>
 #include <vector>
 #include <map>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define DFHACK_HAVE_SSE2
+#endif
+
 #include "MemAccess.h"
 #include "Core.h"
 #include "Error.h"
@@ -70,6 +77,7 @@ distribution.
 #include "df/activity_event.h"
 #include "df/job.h"
 #include "df/job_item.h"
+#include "df/manager_order.h"
 #include "df/building.h"
 #include "df/unit.h"
 #include "df/item.h"
@@ -1356,6 +1364,202 @@ static void OpenRandom(lua_State *state)
     lua_pop(state, 1);
 }
 
+/****************
+ * Search index *
+ ****************/
+
+static int DFHACK_SEARCHINDEX_TOKEN = 0;
+
+// Normalized search keys and the offsets of the words in them. The last
+// filter and its result are kept so that typing more of a filter only
+// needs to recheck the entries that matched before.
+struct SearchIndex
+{
+    std::vector<std::string> keys;
+    // words of keys[i] start at word_starts[word_begin[i]..word_begin[i+1])
+    std::vector<uint32_t> word_starts;
+    std::vector<size_t> word_begin;
+
+    bool has_last;
+    std::vector<std::string> last_tokens;
+    std::vector<int> last_result;
+
+    SearchIndex() : has_last(false) {}
+
+    static bool is_separator(char c)
+    {
+        // same as %s and %p in lua patterns
+        unsigned char uc = (unsigned char)c;
+        return uc == 0 || isspace(uc) || ispunct(uc);
+    }
+
+    void add_key(const std::string &key)
+    {
+        keys.push_back(to_search_normalized(key));
+        const std::string &nkey = keys.back();
+        word_begin.push_back(word_starts.size());
+        for (size_t i = 0; i < nkey.size(); i++)
+        {
+            if (!is_separator(nkey[i]) && (i == 0 || is_separator(nkey[i-1])))
+                word_starts.push_back(uint32_t(i));
+        }
+    }
+
+    bool matches(int idx, const std::vector<std::string> &tokens) const
+    {
+        const std::string &key = keys[idx];
+        for (auto &token : tokens)
+        {
+            bool found = false;
+            for (size_t w = word_begin[idx]; w < word_begin[idx+1] && !found; w++)
+            {
+                uint32_t start = word_starts[w];
+                found = key.size() - start >= token.size() &&
+                        memcmp(key.data() + start, token.data(), token.size()) == 0;
+            }
+            if (!found)
+                return false;
+        }
+        return true;
+    }
+
+    // true if everything matching tokens also matched the last filter
+    bool narrows_last(const std::vector<std::string> &tokens) const
+    {
+        if (!has_last || tokens.size() < last_tokens.size())
+            return false;
+        for (size_t i = 0; i < last_tokens.size(); i++)
+        {
+            if (tokens[i].compare(0, last_tokens[i].size(), last_tokens[i]) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    void filter(const std::string &text, std::vector<int> *out)
+    {
+        std::vector<std::string> words, tokens;
+        split_string(&words, text, " ");
+        for (auto &word : words)
+        {
+            if (!word.empty())
+                tokens.push_back(to_search_normalized(word));
+        }
+
+        out->clear();
+        if (narrows_last(tokens))
+        {
+            for (int idx : last_result)
+                if (matches(idx, tokens))
+                    out->push_back(idx);
+        }
+        else
+        {
+            for (size_t idx = 0; idx < keys.size(); idx++)
+                if (matches(idx, tokens))
+                    out->push_back(idx);
+        }
+
+        has_last = true;
+        last_tokens.swap(tokens);
+        last_result = *out;
+    }
+};
+
+static SearchIndex *check_searchindex_native(lua_State *L, int index)
+{
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &DFHACK_SEARCHINDEX_TOKEN);
+
+    if (!lua_getmetatable(L, index) || !lua_rawequal(L, -1, -2))
+        luaL_argerror(L, index, "not a search index object");
+
+    lua_pop(L, 2);
+
+    return (SearchIndex*)lua_touserdata(L, index);
+}
+
+static int dfhack_searchindex_new(lua_State *L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    int cnt = lua_rawlen(L, 1);
+
+    SearchIndex *index = new (L) SearchIndex();
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &DFHACK_SEARCHINDEX_TOKEN);
+    lua_setmetatable(L, -2);
+
+    index->keys.reserve(cnt);
+    index->word_begin.reserve(cnt + 1);
+    for (int i = 1; i <= cnt; i++)
+    {
+        lua_rawgeti(L, 1, i);
+        size_t len = 0;
+        const char *key = lua_type(L, -1) == LUA_TSTRING ? lua_tolstring(L, -1, &len) : "";
+        index->add_key(std::string(key, len));
+        lua_pop(L, 1);
+    }
+    index->word_begin.push_back(index->word_starts.size());
+
+    return 1;
+}
+
+static int dfhack_searchindex_gc(lua_State *L)
+{
+    check_searchindex_native(L, 1)->~SearchIndex();
+    return 0;
+}
+
+static int dfhack_searchindex_filter(lua_State *L)
+{
+    SearchIndex *index = check_searchindex_native(L, 1);
+    std::string text = luaL_optstring(L, 2, "");
+    int pos = luaL_optint(L, 3, 0);
+
+    std::vector<int> result;
+    index->filter(text, &result);
+
+    int new_pos = 0;
+    lua_createtable(L, result.size(), 0);
+    for (size_t i = 0; i < result.size(); i++)
+    {
+        lua_pushinteger(L, result[i] + 1);
+        lua_rawseti(L, -2, i + 1);
+        if (result[i] + 1 == pos)
+            new_pos = i + 1;
+    }
+
+    if (new_pos)
+        lua_pushinteger(L, new_pos);
+    else
+        lua_pushnil(L);
+    return 2;
+}
+
+static int dfhack_searchindex_size(lua_State *L)
+{
+    lua_pushinteger(L, check_searchindex_native(L, 1)->keys.size());
+    return 1;
+}
+
+static const luaL_Reg dfhack_searchindex_funcs[] = {
+    { "new", dfhack_searchindex_new },
+    { "filter", dfhack_searchindex_filter },
+    { "size", dfhack_searchindex_size },
+    { "__gc", dfhack_searchindex_gc },
+    { NULL, NULL }
+};
+
+static void OpenSearchIndex(lua_State *state)
+{
+    luaL_getsubtable(state, lua_gettop(state), "searchindex");
+
+    lua_dup(state);
+    lua_rawsetp(state, LUA_REGISTRYINDEX, &DFHACK_SEARCHINDEX_TOKEN);
+
+    luaL_setfuncs(state, dfhack_searchindex_funcs, 0);
+
+    lua_pop(state, 1);
+}
+
 /************************
  * Wrappers for C++ API *
  ************************/
@@ -1415,7 +1619,7 @@ static bool isWorldLoaded() { return Core::getInstance().isWorldLoaded(); }
 static bool isMapLoaded() { return Core::getInstance().isMapLoaded(); }
 
 static std::string df2utf(std::string s) { return DF2UTF(s); }
-static std::string utf2df(std::string s) { return UTF2DF(s); }
+static std::string utf2df(std::string s) { UTF2DFInPlace(s); return s; }
 static std::string df2console(color_ostream &out, std::string s) { return DF2CONSOLE(out, s); }
 static std::string toSearchNormalized(std::string s) { return to_search_normalized(s); }
 
@@ -1564,8 +1768,96 @@ static int job_listNewlyCreated(lua_State *state)
         return 1;
 }
 
+// Signature fields are given as a list of manager_order field names.
+static int get_order_fields(lua_State *state, int idx)
+{
+    if (lua_isnoneornil(state, idx))
+        return Job::ORDER_SIGNATURE_ALL;
+
+    static const struct { const char *name; int field; } names[] = {
+        { "job_type", Job::ORDER_JOB_TYPE },
+        { "reaction_name", Job::ORDER_REACTION_NAME },
+        { "item_type", Job::ORDER_ITEM_TYPE },
+        { "item_subtype", Job::ORDER_ITEM_SUBTYPE },
+        { "mat_type", Job::ORDER_MAT_TYPE },
+        { "mat_index", Job::ORDER_MAT_INDEX },
+        { "item_category", Job::ORDER_ITEM_CATEGORY },
+        { "material_category", Job::ORDER_MATERIAL_CATEGORY },
+        { "hist_figure_id", Job::ORDER_HIST_FIGURE },
+    };
+
+    luaL_checktype(state, idx, LUA_TTABLE);
+    int fields = 0;
+    int len = lua_rawlen(state, idx);
+    for (int i = 1; i <= len; i++)
+    {
+        lua_rawgeti(state, idx, i);
+        const char *name = luaL_checkstring(state, -1);
+        size_t j = 0;
+        for (; j < sizeof(names)/sizeof(names[0]); j++)
+        {
+            if (strcmp(names[j].name, name) == 0)
+                break;
+        }
+        if (j == sizeof(names)/sizeof(names[0]))
+            luaL_error(state, "unknown manager order field: %s", name);
+        fields |= names[j].field;
+        lua_pop(state, 1);
+    }
+    return fields;
+}
+
+static int job_findOrders(lua_State *state)
+{
+    auto pattern = Lua::CheckDFObject<df::manager_order>(state, 1);
+    int fields = get_order_fields(state, 2);
+
+    std::vector<df::manager_order*> orders;
+    Job::findOrders(&orders, pattern, fields);
+    Lua::PushVector(state, orders);
+    return 1;
+}
+
+static int job_getOrderAmountLeft(lua_State *state)
+{
+    auto pattern = Lua::CheckDFObject<df::manager_order>(state, 1);
+    int fields = get_order_fields(state, 2);
+
+    lua_pushinteger(state, Job::getOrderAmountLeft(pattern, fields));
+    return 1;
+}
+
+static int job_ensureOrderAmounts(lua_State *state)
+{
+    luaL_checktype(state, 1, LUA_TTABLE);
+    int fields = get_order_fields(state, 2);
+    bool add_new = lua_toboolean(state, 3);
+
+    std::vector<df::manager_order*> patterns;
+    std::vector<int> amounts;
+    int len = lua_rawlen(state, 1);
+    for (int i = 1; i <= len; i++)
+    {
+        lua_rawgeti(state, 1, i);
+        luaL_checktype(state, -1, LUA_TTABLE);
+        lua_rawgeti(state, -1, 1);
+        patterns.push_back(Lua::CheckDFObject<df::manager_order>(state, -1));
+        lua_rawgeti(state, -2, 2);
+        amounts.push_back(luaL_checkint(state, -1));
+        lua_pop(state, 3);
+    }
+
+    std::vector<df::manager_order*> created;
+    Job::ensureOrderAmounts(patterns, amounts, fields, add_new, &created);
+    Lua::PushVector(state, created);
+    return 1;
+}
+
 static const luaL_Reg dfhack_job_funcs[] = {
     { "listNewlyCreated", job_listNewlyCreated },
+    { "findOrders", job_findOrders },
+    { "getOrderAmountLeft", job_getOrderAmountLeft },
+    { "ensureOrderAmounts", job_ensureOrderAmounts },
     { NULL, NULL }
 };
 
@@ -1705,6 +1997,14 @@ static int units_getUnitsInBox(lua_State *state)
     return 2;
 }
 
+static int units_getCitizens(lua_State *state)
+{
+    std::vector<df::unit*> citizens;
+    Units::getCitizens(citizens);
+    Lua::PushVector(state, citizens);
+    return 1;
+}
+
 static int units_getStressCutoffs(lua_State *L)
 {
     lua_newtable(L);
@@ -1717,6 +2017,7 @@ static const luaL_Reg dfhack_units_funcs[] = {
     { "getPosition", units_getPosition },
     { "getNoblePositions", units_getNoblePositions },
     { "getUnitsInBox", units_getUnitsInBox },
+    { "getCitizens", units_getCitizens },
     { "getStressCutoffs", units_getStressCutoffs },
     { NULL, NULL }
 };
@@ -2822,6 +3123,346 @@ static int internal_diffscan(lua_State *L)
     return 1;
 }
 
+/*
+ * Batch scanners. These report every hit, up to max_hits, into an int64_t
+ * buffer supplied by the caller, so that scripts don't have to call back
+ * into C for each match.
+ */
+
+// Step indices of needle matches at base + i*step for i in [0, count).
+// With a negative step, positions are checked from the highest address
+// down. Candidates are found 16 bytes at a time by matching the first
+// and last byte of the needle.
+static int64_t memscan_all(const uint8_t *base, int64_t count, int64_t step,
+                           const uint8_t *needle, size_t nsize,
+                           int64_t *out, int64_t max_hits)
+{
+    if (count <= 0 || max_hits <= 0)
+        return 0;
+
+    bool reverse = step < 0;
+    uint64_t astep = reverse ? uint64_t(-step) : uint64_t(step);
+    // positions are at offsets k*astep from the lowest one
+    const uint8_t *lo = reverse ? base + (count-1)*step : base;
+    int64_t hits = 0;
+
+    auto add_hit = [&](uint64_t k) -> bool {
+        out[hits++] = reverse ? count-1-int64_t(k) : int64_t(k);
+        return hits < max_hits;
+    };
+    auto check_pos = [&](uint64_t k) -> bool {
+        const uint8_t *p = lo + k*astep;
+        if (nsize > 0 && (p[0] != needle[0] || memcmp(p, needle, nsize) != 0))
+            return true;
+        return add_hit(k);
+    };
+    auto check_range = [&](uint64_t first, uint64_t last) -> bool {
+        // positions in [first, last], in scan order
+        if (first > last)
+            return true;
+        if (reverse)
+        {
+            for (uint64_t k = last + 1; k-- > first; )
+                if (!check_pos(k))
+                    return false;
+        }
+        else
+        {
+            for (uint64_t k = first; k <= last; k++)
+                if (!check_pos(k))
+                    return false;
+        }
+        return true;
+    };
+
+    uint64_t last_pos = uint64_t(count - 1);
+    uint64_t last_off = last_pos * astep;
+
+#ifdef DFHACK_HAVE_SSE2
+    if (nsize > 0 && astep <= 16 && last_off >= 15)
+    {
+        // chunk c covers offsets [16c, 16c+15]; both loads stay inside
+        // the scanned area as long as 16c+15 <= last_off
+        uint64_t nchunks = (last_off - 15) / 16 + 1;
+        uint64_t tail_pos = (nchunks*16 + astep - 1) / astep;
+
+        unsigned stride_mask = 0xFFFF;
+        if ((astep & (astep - 1)) == 0)
+        {
+            stride_mask = 0;
+            for (unsigned j = 0; j < 16; j += unsigned(astep))
+                stride_mask |= 1u << j;
+        }
+
+        const __m128i first_byte = _mm_set1_epi8(char(needle[0]));
+        const __m128i last_byte = _mm_set1_epi8(char(needle[nsize-1]));
+
+        auto chunk_mask = [&](uint64_t c) -> unsigned {
+            const uint8_t *p = lo + c*16;
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), first_byte)) &
+                   _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + nsize - 1)), last_byte)) &
+                   stride_mask;
+        };
+        auto check_chunk = [&](uint64_t c, unsigned m) -> bool {
+            for (int i = 0; m && i < 16; i++)
+            {
+                int j = reverse ? 15 - i : i;
+                if (!(m & (1u << j)))
+                    continue;
+                m &= ~(1u << j);
+                uint64_t off = c*16 + j;
+                if (off % astep != 0 || memcmp(lo + off, needle, nsize) != 0)
+                    continue;
+                if (!add_hit(off / astep))
+                    return false;
+            }
+            return true;
+        };
+
+        if (reverse)
+        {
+            if (!check_range(tail_pos, last_pos))
+                return hits;
+            uint64_t c = nchunks;
+            for (; c >= 4; c -= 4)
+            {
+                unsigned m3 = chunk_mask(c-1), m2 = chunk_mask(c-2);
+                unsigned m1 = chunk_mask(c-3), m0 = chunk_mask(c-4);
+                if (!(m0 | m1 | m2 | m3))
+                    continue;
+                if ((m3 && !check_chunk(c-1, m3)) || (m2 && !check_chunk(c-2, m2)) ||
+                    (m1 && !check_chunk(c-3, m1)) || (m0 && !check_chunk(c-4, m0)))
+                    return hits;
+            }
+            while (c-- > 0)
+            {
+                unsigned m = chunk_mask(c);
+                if (m && !check_chunk(c, m))
+                    return hits;
+            }
+        }
+        else
+        {
+            uint64_t c = 0;
+            // test four chunks at a time, since most have no candidates
+            for (; c + 4 <= nchunks; c += 4)
+            {
+                unsigned m0 = chunk_mask(c), m1 = chunk_mask(c+1);
+                unsigned m2 = chunk_mask(c+2), m3 = chunk_mask(c+3);
+                if (!(m0 | m1 | m2 | m3))
+                    continue;
+                if ((m0 && !check_chunk(c, m0)) || (m1 && !check_chunk(c+1, m1)) ||
+                    (m2 && !check_chunk(c+2, m2)) || (m3 && !check_chunk(c+3, m3)))
+                    return hits;
+            }
+            for (; c < nchunks; c++)
+            {
+                unsigned m = chunk_mask(c);
+                if (m && !check_chunk(c, m))
+                    return hits;
+            }
+            check_range(tail_pos, last_pos);
+        }
+        return hits;
+    }
+#endif
+
+    check_range(0, last_pos);
+    return hits;
+}
+
+template<class T>
+struct diffscan_filter
+{
+    bool has_oldv, has_newv, has_diffv;
+    T oldv, newv, diffv;
+
+    bool matches(T o, T n) const
+    {
+        return o != n &&
+               (!has_oldv || o == oldv) &&
+               (!has_newv || n == newv) &&
+               (!has_diffv || T(n - o) == diffv);
+    }
+};
+
+#ifdef DFHACK_HAVE_SSE2
+static inline __m128i simd_set1(uint8_t v) { return _mm_set1_epi8(char(v)); }
+static inline __m128i simd_set1(uint16_t v) { return _mm_set1_epi16(short(v)); }
+static inline __m128i simd_set1(uint32_t v) { return _mm_set1_epi32(int(v)); }
+static inline __m128i simd_cmpeq(__m128i a, __m128i b, uint8_t) { return _mm_cmpeq_epi8(a, b); }
+static inline __m128i simd_cmpeq(__m128i a, __m128i b, uint16_t) { return _mm_cmpeq_epi16(a, b); }
+static inline __m128i simd_cmpeq(__m128i a, __m128i b, uint32_t) { return _mm_cmpeq_epi32(a, b); }
+static inline __m128i simd_sub(__m128i a, __m128i b, uint8_t) { return _mm_sub_epi8(a, b); }
+static inline __m128i simd_sub(__m128i a, __m128i b, uint16_t) { return _mm_sub_epi16(a, b); }
+static inline __m128i simd_sub(__m128i a, __m128i b, uint32_t) { return _mm_sub_epi32(a, b); }
+#endif
+
+// Indices in [start_idx, end_idx) where the elements differ and match the filter.
+template<class T>
+static int64_t diffscan_all(const T *pold, const T *pnew, int64_t start_idx, int64_t end_idx,
+                            const diffscan_filter<T> &filter, int64_t *out, int64_t max_hits)
+{
+    int64_t hits = 0;
+    int64_t i = start_idx;
+    if (max_hits <= 0)
+        return 0;
+
+#ifdef DFHACK_HAVE_SSE2
+    const int64_t lanes = 16 / sizeof(T);
+    const __m128i oldv = simd_set1(filter.oldv);
+    const __m128i newv = simd_set1(filter.newv);
+    const __m128i diffv = simd_set1(filter.diffv);
+    const __m128i ones = _mm_set1_epi8(char(0xFF));
+    for (; i + lanes <= end_idx; i += lanes)
+    {
+        __m128i o = _mm_loadu_si128((const __m128i*)(pold + i));
+        __m128i n = _mm_loadu_si128((const __m128i*)(pnew + i));
+        __m128i hit = _mm_xor_si128(simd_cmpeq(o, n, T()), ones);
+        if (filter.has_oldv)
+            hit = _mm_and_si128(hit, simd_cmpeq(o, oldv, T()));
+        if (filter.has_newv)
+            hit = _mm_and_si128(hit, simd_cmpeq(n, newv, T()));
+        if (filter.has_diffv)
+            hit = _mm_and_si128(hit, simd_cmpeq(simd_sub(n, o, T()), diffv, T()));
+        unsigned m = _mm_movemask_epi8(hit);
+        if (!m)
+            continue;
+        for (int64_t j = 0; j < lanes; j++)
+        {
+            if (!(m & (1u << (j*sizeof(T)))))
+                continue;
+            out[hits++] = i + j;
+            if (hits >= max_hits)
+                return hits;
+        }
+    }
+#endif
+
+    for (; i < end_idx; i++)
+    {
+        if (!filter.matches(pold[i], pnew[i]))
+            continue;
+        out[hits++] = i;
+        if (hits >= max_hits)
+            break;
+    }
+    return hits;
+}
+
+// Keeps the indices from idx_list that match the filter; out may be idx_list.
+template<class T>
+static int64_t diffscan_filter_list(lua_State *L, const T *pold, const T *pnew, int64_t end_idx,
+                                    const diffscan_filter<T> &filter,
+                                    const int64_t *idx_list, int64_t idx_count, int64_t *out)
+{
+    int64_t hits = 0;
+    for (int64_t i = 0; i < idx_count; i++)
+    {
+        int64_t idx = idx_list[i];
+        if (idx < 0 || idx >= end_idx)
+            luaL_error(L, "Index out of bounds: %I", (lua_Integer)idx);
+        if (filter.matches(pold[idx], pnew[idx]))
+            out[hits++] = idx;
+    }
+    return hits;
+}
+
+template<class T>
+static diffscan_filter<T> check_diffscan_filter(lua_State *L, int idx)
+{
+    diffscan_filter<T> filter;
+    filter.has_oldv = !lua_isnil(L, idx);
+    filter.has_newv = !lua_isnil(L, idx+1);
+    filter.has_diffv = !lua_isnil(L, idx+2);
+    filter.oldv = (T)luaL_optinteger(L, idx, 0);
+    filter.newv = (T)luaL_optinteger(L, idx+1, 0);
+    filter.diffv = (T)luaL_optinteger(L, idx+2, 0);
+    return filter;
+}
+
+static int internal_memscanAll(lua_State *L)
+{
+    uint8_t *haystack = (uint8_t*)checkaddr(L, 1);
+    int64_t hcount = luaL_checkinteger(L, 2);
+    int64_t hstep = luaL_checkinteger(L, 3);
+    if (hstep == 0) luaL_argerror(L, 3, "zero step");
+    uint8_t *needle = (uint8_t*)checkaddr(L, 4);
+    int64_t nsize = luaL_checkinteger(L, 5);
+    if (nsize < 0) luaL_argerror(L, 5, "negative size");
+    int64_t *out = (int64_t*)checkaddr(L, 6);
+    int64_t max_hits = luaL_checkinteger(L, 7);
+
+    lua_pushinteger(L, memscan_all(haystack, hcount, hstep, needle, size_t(nsize), out, max_hits));
+    return 1;
+}
+
+static int internal_diffscanAll(lua_State *L)
+{
+    lua_settop(L, 10);
+    void *old_data = checkaddr(L, 1);
+    void *new_data = checkaddr(L, 2);
+    int64_t start_idx = luaL_checkinteger(L, 3);
+    int64_t end_idx = luaL_checkinteger(L, 4);
+    int eltsize = luaL_checkint(L, 5);
+    int64_t *out = (int64_t*)checkaddr(L, 9);
+    int64_t max_hits = luaL_checkinteger(L, 10);
+
+    int64_t hits = 0;
+    switch (eltsize) {
+        case 1:
+            hits = diffscan_all((uint8_t*)old_data, (uint8_t*)new_data, start_idx, end_idx,
+                                check_diffscan_filter<uint8_t>(L, 6), out, max_hits);
+            break;
+        case 2:
+            hits = diffscan_all((uint16_t*)old_data, (uint16_t*)new_data, start_idx, end_idx,
+                                check_diffscan_filter<uint16_t>(L, 6), out, max_hits);
+            break;
+        case 4:
+            hits = diffscan_all((uint32_t*)old_data, (uint32_t*)new_data, start_idx, end_idx,
+                                check_diffscan_filter<uint32_t>(L, 6), out, max_hits);
+            break;
+        default:
+            luaL_argerror(L, 5, "invalid element size");
+    }
+
+    lua_pushinteger(L, hits);
+    return 1;
+}
+
+static int internal_diffscanFilter(lua_State *L)
+{
+    lua_settop(L, 10);
+    void *old_data = checkaddr(L, 1);
+    void *new_data = checkaddr(L, 2);
+    int64_t *idx_list = (int64_t*)checkaddr(L, 3);
+    int64_t idx_count = luaL_checkinteger(L, 4);
+    int64_t end_idx = luaL_checkinteger(L, 5);
+    int eltsize = luaL_checkint(L, 6);
+    int64_t *out = (int64_t*)checkaddr(L, 10);
+
+    int64_t hits = 0;
+    switch (eltsize) {
+        case 1:
+            hits = diffscan_filter_list(L, (uint8_t*)old_data, (uint8_t*)new_data, end_idx,
+                                        check_diffscan_filter<uint8_t>(L, 7), idx_list, idx_count, out);
+            break;
+        case 2:
+            hits = diffscan_filter_list(L, (uint16_t*)old_data, (uint16_t*)new_data, end_idx,
+                                        check_diffscan_filter<uint16_t>(L, 7), idx_list, idx_count, out);
+            break;
+        case 4:
+            hits = diffscan_filter_list(L, (uint32_t*)old_data, (uint32_t*)new_data, end_idx,
+                                        check_diffscan_filter<uint32_t>(L, 7), idx_list, idx_count, out);
+            break;
+        default:
+            luaL_argerror(L, 6, "invalid element size");
+    }
+
+    lua_pushinteger(L, hits);
+    return 1;
+}
+
 static int internal_runCommand(lua_State *L)
 {
     color_ostream *out = NULL;
@@ -2968,6 +3609,51 @@ static int internal_threadid(lua_State *L)
     return 1;
 }
 
+static void push_suspend_histogram(lua_State *L, const std::vector<uint64_t> &histogram)
+{
+    lua_createtable(L, histogram.size(), 0);
+    for (size_t i = 0; i < histogram.size(); i++)
+    {
+        lua_pushinteger(L, histogram[i]);
+        lua_rawseti(L, -2, i+1);
+    }
+}
+
+static int internal_getSuspendStats(lua_State *L)
+{
+    auto stats = Core::getInstance().getSuspendStats();
+
+    lua_createtable(L, stats.size(), 0);
+
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        lua_newtable(L);
+        lua_pushstring(L, stats[i].caller.c_str());
+        lua_setfield(L, -2, "caller");
+        lua_pushboolean(L, stats[i].shared);
+        lua_setfield(L, -2, "shared");
+        lua_pushinteger(L, stats[i].count);
+        lua_setfield(L, -2, "count");
+        lua_pushinteger(L, stats[i].wait_us);
+        lua_setfield(L, -2, "wait_us");
+        lua_pushinteger(L, stats[i].hold_us);
+        lua_setfield(L, -2, "hold_us");
+        push_suspend_histogram(L, stats[i].wait_histogram);
+        lua_setfield(L, -2, "wait_histogram");
+        push_suspend_histogram(L, stats[i].hold_histogram);
+        lua_setfield(L, -2, "hold_histogram");
+        lua_rawseti(L, -2, i+1);
+    }
+
+    return 1;
+}
+
+static int internal_resetSuspendStats(lua_State *L)
+{
+    Core::getInstance().resetSuspendStats();
+    return 0;
+}
+
 static int internal_md5file(lua_State *L)
 {
     const char *s = luaL_checkstring(L, 1);
@@ -3008,6 +3694,315 @@ static int internal_md5file(lua_State *L)
     }
 }
 
+/*
+ * Native versions of utils.binsearch, linear_index and sort_vector for the
+ * common cases: a vector of struct pointers keyed by an integer or enum
+ * field, or a vector of integers. They work on the std::vector storage
+ * directly instead of going through the container metamethods. When the
+ * vector or key is of any other kind they return nothing, and the Lua
+ * implementations take over.
+ */
+
+enum vector_key_kind {
+    VKEY_NONE, VKEY_INT8, VKEY_UINT8, VKEY_INT16, VKEY_UINT16,
+    VKEY_INT32, VKEY_UINT32, VKEY_INT64, VKEY_UINT64
+};
+
+static vector_key_kind get_vector_key_kind(type_identity *type)
+{
+    if (type && type->type() == IDTYPE_ENUM)
+        type = static_cast<enum_identity*>(type)->getBaseType();
+    if (!type || type->type() != IDTYPE_PRIMITIVE)
+        return VKEY_NONE;
+
+    using df::identity_traits;
+    bool is_unsigned =
+        type == identity_traits<unsigned char>::get() ||
+        type == identity_traits<unsigned short>::get() ||
+        type == identity_traits<unsigned int>::get() ||
+        type == identity_traits<unsigned long>::get() ||
+        type == identity_traits<unsigned long long>::get();
+    bool is_signed =
+        type == identity_traits<char>::get() ||
+        type == identity_traits<signed char>::get() ||
+        type == identity_traits<short>::get() ||
+        type == identity_traits<int>::get() ||
+        type == identity_traits<long>::get() ||
+        type == identity_traits<long long>::get();
+    if (!is_unsigned && !is_signed)
+        return VKEY_NONE;
+
+    switch (type->byte_size())
+    {
+    case 1: return is_unsigned ? VKEY_UINT8 : VKEY_INT8;
+    case 2: return is_unsigned ? VKEY_UINT16 : VKEY_INT16;
+    case 4: return is_unsigned ? VKEY_UINT32 : VKEY_INT32;
+    case 8: return is_unsigned ? VKEY_UINT64 : VKEY_INT64;
+    }
+    return VKEY_NONE;
+}
+
+static int64_t read_vector_key(const void *ptr, vector_key_kind kind)
+{
+    switch (kind)
+    {
+    case VKEY_INT8: return *(const int8_t*)ptr;
+    case VKEY_UINT8: return *(const uint8_t*)ptr;
+    case VKEY_INT16: return *(const int16_t*)ptr;
+    case VKEY_UINT16: return *(const uint16_t*)ptr;
+    case VKEY_INT32: return *(const int32_t*)ptr;
+    case VKEY_UINT32: return *(const uint32_t*)ptr;
+    case VKEY_INT64: return *(const int64_t*)ptr;
+    case VKEY_UINT64: return int64_t(*(const uint64_t*)ptr);
+    default: return 0;
+    }
+}
+
+// A vector the native helpers can work on, with how to get at each key.
+struct native_vector
+{
+    void *ptr = NULL;
+    size_t size = 0;
+    bool pointers = false;      // std::vector<T*> keyed by a field at offset
+    size_t offset = 0;
+    size_t item_size = 0;       // otherwise std::vector of integers
+    vector_key_kind kind = VKEY_NONE;
+
+    const void *item(size_t i) const
+    {
+        if (pointers)
+            return (*(std::vector<void*>*)ptr)[i];
+        return (*(std::vector<uint8_t>*)ptr).data() + i * item_size;
+    }
+
+    // Returns false for null elements, which the Lua versions fail on.
+    bool key(size_t i, int64_t *out) const
+    {
+        const void *p = item(i);
+        if (!p)
+            return false;
+        *out = read_vector_key((const uint8_t*)p + offset, kind);
+        return true;
+    }
+};
+
+static const struct_field_info *find_struct_field(struct_identity *type, const char *name)
+{
+    for (; type; type = type->getParent())
+    {
+        auto fields = type->getFields();
+        for (size_t i = 0; fields && fields[i].mode != struct_field_info::END; i++)
+        {
+            if (strcmp(fields[i].name, name) == 0)
+                return &fields[i];
+        }
+    }
+    return NULL;
+}
+
+static bool get_native_vector(lua_State *L, int vec_idx, int field_idx, native_vector *out)
+{
+    if (Lua::IsDFObject(L, vec_idx) != Lua::OBJ_REF)
+        return false;
+
+    auto id = LuaWrapper::get_object_identity(L, vec_idx, "native vector helper");
+    out->ptr = LuaWrapper::get_object_ref(L, vec_idx);
+    if (!out->ptr)
+        return false;
+
+    if (id->type() == IDTYPE_STL_PTR_VECTOR)
+    {
+        if (!lua_isstring(L, field_idx))
+            return false;
+
+        auto item = static_cast<container_identity*>(id)->getItemType();
+        if (!item || (item->type() != IDTYPE_STRUCT && item->type() != IDTYPE_CLASS))
+            return false;
+
+        auto field = find_struct_field(static_cast<struct_identity*>(item), lua_tostring(L, field_idx));
+        if (!field || field->mode != struct_field_info::PRIMITIVE)
+            return false;
+
+        out->kind = get_vector_key_kind(field->type);
+        out->pointers = true;
+        out->offset = field->offset;
+        out->size = static_cast<std::vector<void*>*>(out->ptr)->size();
+        return out->kind != VKEY_NONE;
+    }
+
+    if (!lua_isnil(L, field_idx) && !lua_isnone(L, field_idx))
+        return false;
+
+    size_t item_size = 0;
+    if (id == df::identity_traits<std::vector<int8_t> >::get() ||
+        id == df::identity_traits<std::vector<uint8_t> >::get())
+        item_size = 1;
+    else if (id == df::identity_traits<std::vector<int16_t> >::get() ||
+             id == df::identity_traits<std::vector<uint16_t> >::get())
+        item_size = 2;
+    else if (id == df::identity_traits<std::vector<int32_t> >::get() ||
+             id == df::identity_traits<std::vector<uint32_t> >::get())
+        item_size = 4;
+    else
+        return false;
+
+    out->kind = get_vector_key_kind(static_cast<container_identity*>(id)->getItemType());
+    out->item_size = item_size;
+    out->size = static_cast<std::vector<uint8_t>*>(out->ptr)->size() / item_size;
+    return out->kind != VKEY_NONE;
+}
+
+static int compare_vector_key(int64_t value, lua_Number key)
+{
+    lua_Number v = lua_Number(value);
+    return v < key ? -1 : (v > key ? 1 : 0);
+}
+
+static int internal_vectorBinsearch(lua_State *L)
+{
+    native_vector vec;
+    if (lua_type(L, 2) != LUA_TNUMBER || !get_native_vector(L, 1, 3, &vec))
+        return 0;
+
+    lua_Number key = lua_tonumber(L, 2);
+    // Like utils.binsearch, the bounds are only used if both are given.
+    int64_t min = -1, max = int64_t(vec.size);
+    if (!lua_isnoneornil(L, 4) && !lua_isnoneornil(L, 5))
+    {
+        min = luaL_checkinteger(L, 4);
+        max = luaL_checkinteger(L, 5);
+        if (min < -1 || max > int64_t(vec.size))
+            return 0;
+    }
+
+    for (;;)
+    {
+        int64_t mid = (min + max) >> 1;
+        if (mid <= min)
+        {
+            lua_pushboolean(L, false);
+            lua_pushinteger(L, max);
+            return 2;
+        }
+
+        int64_t value;
+        if (!vec.key(size_t(mid), &value))
+            return 0;
+
+        int cv = compare_vector_key(value, key);
+        if (cv == 0)
+        {
+            lua_pushboolean(L, true);
+            lua_pushinteger(L, mid);
+            return 2;
+        }
+        else if (cv < 0)
+            min = mid;
+        else
+            max = mid;
+    }
+}
+
+static int internal_vectorLinearIndex(lua_State *L)
+{
+    // Without a field, a vector of pointers is searched for the object itself.
+    if (lua_isnoneornil(L, 3) && Lua::IsDFObject(L, 1) == Lua::OBJ_REF &&
+        LuaWrapper::get_object_identity(L, 1, "vectorLinearIndex")->type() == IDTYPE_STL_PTR_VECTOR)
+    {
+        if (Lua::IsDFObject(L, 2) != Lua::OBJ_REF)
+            return 0;
+
+        auto &items = *(std::vector<void*>*)LuaWrapper::get_object_ref(L, 1);
+        void *key = LuaWrapper::get_object_ref(L, 2);
+        auto it = std::find(items.begin(), items.end(), key);
+        lua_pushinteger(L, it == items.end() ? -1 : lua_Integer(it - items.begin()));
+        return 1;
+    }
+
+    native_vector vec;
+    if (lua_type(L, 2) != LUA_TNUMBER || !get_native_vector(L, 1, 3, &vec))
+        return 0;
+
+    lua_Number key = lua_tonumber(L, 2);
+    for (size_t i = 0; i < vec.size; i++)
+    {
+        int64_t value;
+        if (!vec.key(i, &value))
+            return 0;
+        if (compare_vector_key(value, key) == 0)
+        {
+            lua_pushinteger(L, i);
+            return 1;
+        }
+    }
+    lua_pushinteger(L, -1);
+    return 1;
+}
+
+struct vector_sort_entry
+{
+    int64_t key;
+    size_t index;
+};
+
+static int internal_vectorSort(lua_State *L)
+{
+    native_vector vec;
+    if (!get_native_vector(L, 1, 2, &vec))
+        return 0;
+
+    bool has_cmp = !lua_isnoneornil(L, 3);
+    if (has_cmp)
+        luaL_checktype(L, 3, LUA_TFUNCTION);
+
+    std::vector<vector_sort_entry> entries(vec.size);
+    for (size_t i = 0; i < vec.size; i++)
+    {
+        if (!vec.key(i, &entries[i].key))
+            return 0;
+        entries[i].index = i;
+    }
+
+    // A Lua comparator gets the keys, like compare_field passes it the
+    // field values. Errors from it leave the vector untouched, since the
+    // result is only written back once sorting is done.
+    std::stable_sort(entries.begin(), entries.end(),
+        [L, has_cmp](const vector_sort_entry &a, const vector_sort_entry &b) {
+            if (!has_cmp)
+                return a.key < b.key;
+
+            lua_pushvalue(L, 3);
+            lua_pushinteger(L, a.key);
+            lua_pushinteger(L, b.key);
+            lua_call(L, 2, 1);
+            if (!lua_isnumber(L, -1))
+                luaL_error(L, "comparator must return a number");
+            bool less = lua_tonumber(L, -1) < 0;
+            lua_pop(L, 1);
+            return less;
+        });
+
+    if (vec.pointers)
+    {
+        auto &items = *(std::vector<void*>*)vec.ptr;
+        std::vector<void*> sorted(items.size());
+        for (size_t i = 0; i < entries.size(); i++)
+            sorted[i] = items[entries[i].index];
+        items.swap(sorted);
+    }
+    else
+    {
+        auto &bytes = *(std::vector<uint8_t>*)vec.ptr;
+        std::vector<uint8_t> sorted(bytes.size());
+        for (size_t i = 0; i < entries.size(); i++)
+            memcpy(&sorted[i * vec.item_size], &bytes[entries[i].index * vec.item_size], vec.item_size);
+        memcpy(bytes.data(), sorted.data(), sorted.size());
+    }
+
+    lua_pushboolean(L, true);
+    return 1;
+}
+
 static const luaL_Reg dfhack_internal_funcs[] = {
     { "getPE", internal_getPE },
     { "getMD5", internal_getmd5 },
@@ -3022,6 +4017,9 @@ static const luaL_Reg dfhack_internal_funcs[] = {
     { "memcmp", internal_memcmp },
     { "memscan", internal_memscan },
     { "diffscan", internal_diffscan },
+    { "memscanAll", internal_memscanAll },
+    { "diffscanAll", internal_diffscanAll },
+    { "diffscanFilter", internal_diffscanFilter },
     { "getDir", filesystem_listdir },
     { "runCommand", internal_runCommand },
     { "getModifiers", internal_getModifiers },
@@ -3031,6 +4029,11 @@ static const luaL_Reg dfhack_internal_funcs[] = {
     { "findScript", internal_findScript },
     { "threadid", internal_threadid },
     { "md5File", internal_md5file },
+    { "getSuspendStats", internal_getSuspendStats },
+    { "resetSuspendStats", internal_resetSuspendStats },
+    { "vectorBinsearch", internal_vectorBinsearch },
+    { "vectorLinearIndex", internal_vectorLinearIndex },
+    { "vectorSort", internal_vectorSort },
     { NULL, NULL }
 };
 
@@ -3046,6 +4049,7 @@ void OpenDFHackApi(lua_State *state)
     OpenPen(state);
     OpenPenArray(state);
     OpenRandom(state);
+    OpenSearchIndex(state);
 
     LuaWrapper::SetFunctionWrappers(state, dfhack_module);
     OpenModule(state, "gui", dfhack_gui_module, dfhack_gui_funcs);
@@ -36,6 +36,11 @@ distribution.
     #include <ctime>
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define DFHACK_HAVE_SSE2
+#endif
+
 #include <ctype.h>
 #include <stdarg.h>
 #include <string.h>
@@ -43,6 +48,7 @@ distribution.
 
 #include <sstream>
 #include <map>
+#include <algorithm>
 #include <array>
 
 std::string stl_sprintf(const char *fmt, ...) {
@@ -262,6 +268,269 @@ uint64_t GetTimeMs64()
 }
 #endif
 
+/* Dense id tables */
+
+namespace {
+    struct dense_id_table
+    {
+        const std::vector<void*> *vec = NULL;
+        size_t key_offset = 0;
+        bool built = false;
+        // vector size when the table was last built or patched
+        size_t known_size = 0;
+        // table[id - min_id] is the index id had when it was added
+        int32_t min_id = 0;
+        int32_t max_id = -1;
+        std::vector<int32_t> table;
+        // Removals shift later entries down. For every chunk of the vector
+        // as it was built, the id it started with and how far that id has
+        // moved down since.
+        std::vector<int32_t> chunk_ids;
+        std::vector<int32_t> chunk_drift;
+        // how many entries may have been removed since the build
+        size_t removed = 0;
+    };
+}
+
+static const size_t MAX_DENSE_ID_TABLES = 8;
+static const int DENSE_ID_CHUNK_SHIFT = 10;
+static dense_id_table dense_id_tables[MAX_DENSE_ID_TABLES];
+static bool (*dense_id_update_check)() = NULL;
+
+static inline int32_t dense_id_key(const dense_id_table &t, size_t idx)
+{
+    return *(const int32_t*)((const char*)(*t.vec)[idx] + t.key_offset);
+}
+
+// Index of the first entry with an id >= key, searching outwards from guess.
+static int dense_id_lower_bound(const dense_id_table &t, int32_t key, int guess)
+{
+    int size = (int)t.vec->size();
+    if (size == 0)
+        return 0;
+    if (guess < 0)
+        guess = 0;
+    if (guess >= size)
+        guess = size - 1;
+
+    int lo, hi;
+    if (dense_id_key(t, guess) >= key)
+    {
+        hi = guess;
+        for (int step = 1;; step *= 2)
+        {
+            lo = hi - step;
+            if (lo < 0)
+            {
+                lo = -1;
+                break;
+            }
+            if (dense_id_key(t, lo) < key)
+                break;
+            hi = lo;
+        }
+    }
+    else
+    {
+        lo = guess;
+        for (int step = 1;; step *= 2)
+        {
+            hi = lo + step;
+            if (hi >= size)
+            {
+                hi = size;
+                break;
+            }
+            if (dense_id_key(t, hi) >= key)
+                break;
+            lo = hi;
+        }
+    }
+
+    while (hi - lo > 1)
+    {
+        int mid = (lo + hi) >> 1;
+        if (dense_id_key(t, mid) < key)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return hi;
+}
+
+static void dense_id_build(dense_id_table &t)
+{
+    auto &vec = *t.vec;
+    t.built = false;
+    t.known_size = vec.size();
+    t.removed = 0;
+    t.table.clear();
+    t.chunk_ids.clear();
+    t.chunk_drift.clear();
+    if (vec.size() < DENSE_ID_MIN_SIZE)
+        return;
+
+    t.min_id = dense_id_key(t, 0);
+    t.max_id = dense_id_key(t, vec.size() - 1);
+    // Give up on vectors whose ids are too sparse, or not sorted.
+    int64_t span = int64_t(t.max_id) - t.min_id + 1;
+    if (span <= 0 || span > int64_t(vec.size()) * 4)
+        return;
+
+    t.table.assign(size_t(span), -1);
+    for (size_t i = 0; i < vec.size(); i++)
+    {
+        int32_t id = dense_id_key(t, i);
+        if (id >= t.min_id && id <= t.max_id)
+            t.table[id - t.min_id] = int32_t(i);
+        if ((i & ((1 << DENSE_ID_CHUNK_SHIFT) - 1)) == 0)
+            t.chunk_ids.push_back(id);
+    }
+    t.chunk_drift.assign(t.chunk_ids.size(), 0);
+    t.built = true;
+}
+
+static void dense_id_refresh(dense_id_table &t)
+{
+    auto &vec = *t.vec;
+    size_t size = vec.size();
+    if (!t.built)
+    {
+        if (size == t.known_size)
+            return;
+        // Sparse vectors are only retried once their size changed a lot.
+        if (size >= DENSE_ID_MIN_SIZE &&
+            (t.known_size < DENSE_ID_MIN_SIZE || size > t.known_size + t.known_size / 8 ||
+             size < t.known_size - t.known_size / 8))
+            dense_id_build(t);
+        return;
+    }
+
+    if (size == t.known_size && (size == 0 || dense_id_key(t, size - 1) <= t.max_id))
+        return;
+    if (size == 0 || dense_id_key(t, 0) < t.min_id)
+    {
+        dense_id_build(t);
+        return;
+    }
+
+    // Ids only grow, so new entries are at the end with ids above max_id.
+    size_t first_new = size;
+    while (first_new > 0 && dense_id_key(t, first_new - 1) > t.max_id)
+        first_new--;
+    size_t appended = size - first_new;
+    size_t expected = t.known_size + appended;
+    if (expected > size)
+    {
+        t.removed += expected - size;
+        if (t.removed > size / 8 || size < DENSE_ID_MIN_SIZE)
+        {
+            dense_id_build(t);
+            return;
+        }
+
+        // Find where each chunk now starts. The drift only grows along the
+        // vector, so each search starts from the previous chunk's drift.
+        int32_t drift = 0;
+        for (size_t c = 0; c < t.chunk_ids.size(); c++)
+        {
+            int old_start = int(c << DENSE_ID_CHUNK_SHIFT);
+            int now = dense_id_lower_bound(t, t.chunk_ids[c], old_start - drift);
+            drift = old_start - now;
+            t.chunk_drift[c] = drift;
+        }
+    }
+
+    if (appended)
+    {
+        int64_t span = int64_t(dense_id_key(t, size - 1)) - t.min_id + 1;
+        if (span > int64_t(size) * 4)
+        {
+            dense_id_build(t);
+            return;
+        }
+        t.table.resize(size_t(span), -1);
+        for (size_t i = first_new; i < size; i++)
+            t.table[dense_id_key(t, i) - t.min_id] = int32_t(i);
+        t.max_id = dense_id_key(t, size - 1);
+    }
+    t.known_size = size;
+}
+
+bool register_dense_id_vector(const void *vec)
+{
+    for (auto &t : dense_id_tables)
+    {
+        if (t.vec == vec)
+            return true;
+    }
+    for (auto &t : dense_id_tables)
+    {
+        if (!t.vec)
+        {
+            t = dense_id_table();
+            t.vec = (const std::vector<void*>*)vec;
+            return true;
+        }
+    }
+    return false;
+}
+
+void unregister_dense_id_vector(const void *vec)
+{
+    for (auto &t : dense_id_tables)
+    {
+        if (t.vec == vec)
+            t = dense_id_table();
+    }
+}
+
+void set_dense_id_update_check(bool (*check)())
+{
+    dense_id_update_check = check;
+}
+
+int dense_id_lookup(const void *vec, size_t key_offset, int32_t key)
+{
+    dense_id_table *pt = NULL;
+    for (auto &t : dense_id_tables)
+    {
+        if (t.vec == vec)
+        {
+            pt = &t;
+            break;
+        }
+    }
+    if (!pt)
+        return -2;
+
+    auto &t = *pt;
+    if (dense_id_update_check && dense_id_update_check())
+    {
+        if (t.key_offset != key_offset)
+        {
+            t.key_offset = key_offset;
+            dense_id_build(t);
+        }
+        else
+            dense_id_refresh(t);
+    }
+    if (!t.built || t.key_offset != key_offset || key < t.min_id || key > t.max_id)
+        return -2;
+
+    int idx = t.table[key - t.min_id];
+    if (idx < 0)
+        return -2;
+
+    // The table may be a little out of date, so the entry is searched for
+    // around where it is expected to be.
+    size_t chunk = std::min(size_t(idx) >> DENSE_ID_CHUNK_SHIFT, t.chunk_drift.size() - 1);
+    int found = dense_id_lower_bound(t, key, idx - t.chunk_drift[chunk]);
+    if (found < (int)t.vec->size() && dense_id_key(t, found) == key)
+        return found;
+    return -1;
+}
+
 /* Character decoding */
 
 // See http://bjoern.hoehrmann.de/utf-8/decoder/dfa/ for details.
@@ -361,50 +630,117 @@ static uint16_t character_table[256] = {
     0xB0,   0x2219, 0xB7,   0x221A, 0x207F, 0xB2,   0x25A0, 0xA0
 };
 
-std::string DF2UTF(const std::string &in)
+/* Bytes from space to tilde are the same in CP437 and UTF-8, and make up
+ * nearly all DF text, so runs of them are copied without a table lookup. */
+
+static inline bool is_plain_ascii(uint8_t c)
 {
-    std::string out;
-    out.reserve(in.size());
+    return c >= 0x20 && c <= 0x7E;
+}
 
-    uint8_t buf[4];
-    for (size_t i = 0; i < in.size(); i++)
+static size_t plain_ascii_prefix(const char *in, size_t size)
+{
+    size_t i = 0;
+#ifdef DFHACK_HAVE_SSE2
+    const __m128i lo = _mm_set1_epi8(0x1F);
+    const __m128i hi = _mm_set1_epi8(0x7F);
+    for (; i + 16 <= size; i += 16)
     {
-        int cnt = encode(buf, character_table[(uint8_t)in[i]]);
-        out.append(&buf[0], &buf[cnt]);
+        // Signed compares, so bytes >= 0x80 fail the lower bound.
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i ok = _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+        if (_mm_movemask_epi8(ok) != 0xFFFF)
+            break;
     }
+#endif
+    while (i < size && is_plain_ascii(uint8_t(in[i])))
+        i++;
+    return i;
+}
 
-    return out;
+namespace {
+    struct CP437Tables
+    {
+        // UTF-8 encoding of every CP437 byte
+        uint8_t utf8_len[256];
+        uint8_t utf8[256][3];
+        // Every BMP codepoint to CP437, '?' where there is no mapping
+        char from_unicode[0x10000];
+
+        CP437Tables()
+        {
+            memset(from_unicode, '?', sizeof(from_unicode));
+            for (int i = 0; i < 256; i++)
+            {
+                utf8_len[i] = uint8_t(encode(utf8[i], character_table[i]));
+                from_unicode[character_table[i]] = char(i);
+            }
+        }
+    };
 }
 
-std::string UTF2DF(const std::string &in)
+// Built on first use; function-local statics are initialized thread-safely.
+static const CP437Tables &cp437_tables()
+{
+    static const CP437Tables *tables = new CP437Tables();
+    return *tables;
+}
+
+void appendDF2UTF(std::string &out, const char *in, size_t size)
 {
-    // Unicode to normal lookup table
-    static std::map<uint32_t, char> ctable;
+    const CP437Tables &tables = cp437_tables();
+    out.reserve(out.size() + size);
 
-    if (ctable.empty())
+    size_t i = 0;
+    while (i < size)
     {
-        for (uint16_t i = 0; i < 256; i++)
-            if (character_table[i] != i)
-                ctable[character_table[i]] = char(i);
+        size_t run = plain_ascii_prefix(in + i, size - i);
+        out.append(in + i, run);
+        i += run;
+
+        for (; i < size && !is_plain_ascii(uint8_t(in[i])); i++)
+        {
+            uint8_t c = uint8_t(in[i]);
+            out.append(reinterpret_cast<const char*>(tables.utf8[c]), tables.utf8_len[c]);
+        }
     }
+}
+
+std::string DF2UTF(const std::string &in)
+{
+    std::string out;
+    appendDF2UTF(out, in.data(), in.size());
+    return out;
+}
 
-    // Actual conversion loop
-    size_t size = in.size();
-    std::string out(size, char(0));
+// Writes at most size bytes to out, which may be the same buffer as in.
+static size_t utf2df(const char *in, size_t size, char *out)
+{
+    const CP437Tables &tables = cp437_tables();
 
     uint32_t codepoint = 0;
     uint32_t state = UTF8_ACCEPT, prev = UTF8_ACCEPT;
-    uint32_t pos = 0;
+    size_t pos = 0;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        if (state == UTF8_ACCEPT)
+        {
+            size_t run = plain_ascii_prefix(in + i, size - i);
+            if (run > 0)
+            {
+                if (out + pos != in + i)
+                    memmove(out + pos, in + i, run);
+                pos += run;
+                i += run - 1;
+                continue;
+            }
+        }
 
-    for (unsigned i = 0; i < size; prev = state, i++) {
+        prev = state;
         switch (decode(&state, &codepoint, uint8_t(in[i]))) {
         case UTF8_ACCEPT:
-            if (codepoint < 256 && character_table[codepoint] == codepoint) {
-                out[pos++] = char(codepoint);
-            } else {
-                char v = ctable[codepoint];
-                out[pos++] = v ? v : '?';
-            }
+            out[pos++] = codepoint < 0x10000 ? tables.from_unicode[codepoint] : '?';
             break;
 
         case UTF8_REJECT:
@@ -415,12 +751,30 @@ std::string UTF2DF(const std::string &in)
         }
     }
 
-    if (pos != size)
-        out.resize(pos);
+    return pos;
+}
+
+void appendUTF2DF(std::string &out, const char *in, size_t size)
+{
+    size_t old_size = out.size();
+    out.resize(old_size + size);
+    out.resize(old_size + utf2df(in, size, &out[old_size]));
+}
+
+void UTF2DFInPlace(std::string &str)
+{
+    if (!str.empty())
+        str.resize(utf2df(&str[0], str.size(), &str[0]));
+}
+
+std::string UTF2DF(const std::string &in)
+{
+    std::string out;
+    appendUTF2DF(out, in.data(), in.size());
     return out;
 }
 
-DFHACK_EXPORT std::string DF2CONSOLE(const std::string &in)
+static bool console_is_utf()
 {
     bool is_utf = false;
 #ifdef LINUX_BUILD
@@ -433,6 +787,13 @@ DFHACK_EXPORT std::string DF2CONSOLE(const std::string &in)
     is_utf = (locale.find("UTF-8") != std::string::npos) ||
              (locale.find("UTF8") != std::string::npos);
 #endif
+    return is_utf;
+}
+
+DFHACK_EXPORT std::string DF2CONSOLE(const std::string &in)
+{
+    // The locale doesn't change while DF is running.
+    static const bool is_utf = console_is_utf();
     return is_utf ? DF2UTF(in) : in;
 }
 
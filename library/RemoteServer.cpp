@@ -338,10 +338,16 @@ void ServerConnection::threadFn()
 
                 reply = fn->out();
 
+                CoreSuspendCaller caller(fn->name);
                 if (fn->flags & SF_DONT_SUSPEND)
                 {
                     res = fn->execute(stream);
                 }
+                else if (fn->flags & SF_SHARED_SUSPEND)
+                {
+                    SharedCoreSuspender suspend;
+                    res = fn->execute(stream);
+                }
                 else
                 {
                     CoreSuspender suspend;
@@ -64,6 +64,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "df/world.h"
 #include "df/world_data.h"
 #include "df/unit.h"
+#include "df/item.h"
+#include "df/building.h"
 #include "df/unit_misc_trait.h"
 #include "df/unit_soul.h"
 #include "df/unit_skill.h"
@@ -86,6 +88,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <sstream>
 
 #include <memory>
+#include <map>
 
 using namespace DFHack;
 using namespace df::enums;
@@ -666,19 +669,21 @@ CoreService::CoreService() :
     addMethod("CoreResume", &CoreService::CoreResume, SF_DONT_SUSPEND | SF_ALLOW_REMOTE);
 
     addMethod("RunLua", &CoreService::RunLua);
+    addMethod("BindLuaFunction", &CoreService::BindLuaFunction);
+    addMethod("RunLuaValues", &CoreService::RunLuaValues);
 
     // Functions:
     addFunction("GetVersion", GetVersion, SF_DONT_SUSPEND | SF_ALLOW_REMOTE);
     addFunction("GetDFVersion", GetDFVersion, SF_DONT_SUSPEND | SF_ALLOW_REMOTE);
 
-    addFunction("GetWorldInfo", GetWorldInfo, SF_ALLOW_REMOTE);
+    addFunction("GetWorldInfo", GetWorldInfo, SF_SHARED_SUSPEND | SF_ALLOW_REMOTE);
 
     addFunction("ListEnums", ListEnums, SF_CALLED_ONCE | SF_DONT_SUSPEND | SF_ALLOW_REMOTE);
     addFunction("ListJobSkills", ListJobSkills, SF_CALLED_ONCE | SF_DONT_SUSPEND | SF_ALLOW_REMOTE);
 
-    addFunction("ListMaterials", ListMaterials, SF_CALLED_ONCE | SF_ALLOW_REMOTE);
-    addFunction("ListUnits", ListUnits, SF_ALLOW_REMOTE);
-    addFunction("ListSquads", ListSquads, SF_ALLOW_REMOTE);
+    addFunction("ListMaterials", ListMaterials, SF_CALLED_ONCE | SF_SHARED_SUSPEND | SF_ALLOW_REMOTE);
+    addFunction("ListUnits", ListUnits, SF_SHARED_SUSPEND | SF_ALLOW_REMOTE);
+    addFunction("ListSquads", ListSquads, SF_SHARED_SUSPEND | SF_ALLOW_REMOTE);
 
     addFunction("SetUnitLabors", SetUnitLabors, SF_ALLOW_REMOTE);
 }
@@ -769,41 +774,49 @@ command_result CoreService::RunLua(color_ostream &stream,
     return data.rv;
 }
 
-int CoreService::doRunLuaFunction(lua_State *L)
+static bool is_rpc_module(const std::string &module)
 {
-    color_ostream &out = *Lua::GetOutput(L);
-    auto &args = *(LuaFunctionData*)lua_touserdata(L, 1);
-
-    // Verify module name
-    std::string module = args.in->module();
     size_t len = module.size();
 
-    bool valid = false;
-
     if (len > 4)
     {
         if (module.substr(0,4) == "rpc.")
-            valid = true;
+            return true;
         else if ((module[len-4] == '.' || module[len-4] == '-') && module.substr(len-3) != "rpc")
-            valid = true;
+            return true;
     }
 
-    if (!valid)
+    return false;
+}
+
+// Pushes the function onto an empty stack, so that it ends up at index 1
+static command_result push_rpc_function(color_ostream &out, lua_State *L,
+                                        const std::string &module, const std::string &function)
+{
+    if (!is_rpc_module(module))
     {
-        args.rv = CR_WRONG_USAGE;
         out.printerr("Only modules named rpc.* or *.rpc or *-rpc may be called.\n");
-        return 0;
+        return CR_WRONG_USAGE;
     }
 
-    // Prepare function and arguments
     lua_settop(L, 0);
 
-    if (!Lua::PushModulePublic(out, L, module.c_str(), args.in->function().c_str())
+    if (!Lua::PushModulePublic(out, L, module.c_str(), function.c_str())
         || lua_isnil(L, 1))
-    {
-        args.rv = CR_NOT_FOUND;
+        return CR_NOT_FOUND;
+
+    return CR_OK;
+}
+
+int CoreService::doRunLuaFunction(lua_State *L)
+{
+    color_ostream &out = *Lua::GetOutput(L);
+    auto &args = *(LuaFunctionData*)lua_touserdata(L, 1);
+
+    // Prepare function and arguments
+    args.rv = push_rpc_function(out, L, args.in->module(), args.in->function());
+    if (args.rv != CR_OK)
         return 0;
-    }
 
     luaL_checkstack(L, args.in->arguments_size(), "too many arguments");
 
@@ -826,3 +839,356 @@ int CoreService::doRunLuaFunction(lua_State *L)
     args.rv = CR_OK;
     return 0;
 }
+
+/*
+ * Typed Lua calls
+ */
+
+namespace {
+    struct LuaBindData {
+        command_result rv;
+        const dfproto::CoreBindLuaRequest *in;
+        IntMessage *out;
+    };
+
+    struct LuaValuesData {
+        command_result rv;
+        const dfproto::CoreRunLuaValuesRequest *in;
+        dfproto::CoreLuaValueList *out;
+    };
+
+    // DF objects that are passed by type name and id
+    struct lua_object_kind {
+        const char *name;
+        type_identity *(*identity)();
+        void *(*find)(int32_t id);
+        int32_t (*get_id)(void *ptr);
+    };
+
+    template<class T> type_identity *object_identity() { return df::identity_traits<T>::get(); }
+    template<class T> void *find_object(int32_t id) { return T::find(id); }
+    template<class T> int32_t get_object_id(void *ptr) { return ((T*)ptr)->id; }
+
+#define LUA_OBJECT_KIND(type) \
+    { #type, object_identity<df::type>, find_object<df::type>, get_object_id<df::type> }
+
+    const lua_object_kind lua_object_kinds[] = {
+        LUA_OBJECT_KIND(unit),
+        LUA_OBJECT_KIND(item),
+        LUA_OBJECT_KIND(building),
+        LUA_OBJECT_KIND(historical_figure),
+        LUA_OBJECT_KIND(historical_entity),
+    };
+
+#undef LUA_OBJECT_KIND
+
+    const int max_lua_value_depth = 64;
+}
+
+// Bound functions are kept in a registry table, indexed by handle. Handles are
+// shared by all connections, and binding the same function again refreshes it,
+// e.g. after the module was reloaded.
+static char bound_lua_functions_token;
+static std::map<std::pair<std::string,std::string>, int> bound_lua_handles;
+
+static void push_bound_lua_functions(lua_State *L)
+{
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &bound_lua_functions_token);
+    if (lua_istable(L, -1))
+        return;
+
+    lua_pop(L, 1);
+    lua_newtable(L);
+    lua_pushvalue(L, -1);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &bound_lua_functions_token);
+}
+
+static void push_lua_value(lua_State *L, const dfproto::CoreLuaValue &value, int depth)
+{
+    using dfproto::CoreLuaValue;
+
+    if (depth > max_lua_value_depth)
+        luaL_error(L, "Lua value nested too deeply");
+    luaL_checkstack(L, 3, "Lua value nested too deeply");
+
+    switch (value.type())
+    {
+    case CoreLuaValue::BOOLEAN:
+        lua_pushboolean(L, value.bool_value());
+        break;
+    case CoreLuaValue::INTEGER:
+        lua_pushinteger(L, value.int_value());
+        break;
+    case CoreLuaValue::NUMBER:
+        lua_pushnumber(L, value.number_value());
+        break;
+    case CoreLuaValue::STRING:
+        lua_pushlstring(L, value.string_value().data(), value.string_value().size());
+        break;
+    case CoreLuaValue::LIST:
+    {
+        int size = value.int_items_size() + value.number_items_size() + value.items_size();
+        lua_createtable(L, size, 0);
+        int idx = 0;
+        for (int i = 0; i < value.int_items_size(); i++)
+        {
+            lua_pushinteger(L, value.int_items(i));
+            lua_rawseti(L, -2, ++idx);
+        }
+        for (int i = 0; i < value.number_items_size(); i++)
+        {
+            lua_pushnumber(L, value.number_items(i));
+            lua_rawseti(L, -2, ++idx);
+        }
+        for (int i = 0; i < value.items_size(); i++)
+        {
+            push_lua_value(L, value.items(i), depth+1);
+            lua_rawseti(L, -2, ++idx);
+        }
+        break;
+    }
+    case CoreLuaValue::MAP:
+        if (value.keys_size() != value.items_size())
+            luaL_error(L, "Lua map value has %d keys but %d items",
+                       value.keys_size(), value.items_size());
+        lua_createtable(L, 0, value.keys_size());
+        for (int i = 0; i < value.keys_size(); i++)
+        {
+            push_lua_value(L, value.keys(i), depth+1);
+            push_lua_value(L, value.items(i), depth+1);
+            lua_rawset(L, -3);
+        }
+        break;
+    case CoreLuaValue::OBJECT:
+        for (auto &kind : lua_object_kinds)
+        {
+            if (value.object_type() == kind.name)
+            {
+                Lua::PushDFObject(L, kind.identity(), kind.find(value.object_id()));
+                return;
+            }
+        }
+        luaL_error(L, "Unknown object type: %s", value.object_type().c_str());
+        break;
+    default:
+        lua_pushnil(L);
+        break;
+    }
+}
+
+static void encode_lua_value(lua_State *L, int idx, dfproto::CoreLuaValue *value, int depth);
+
+static void encode_lua_table(lua_State *L, int idx, dfproto::CoreLuaValue *value, int depth)
+{
+    using dfproto::CoreLuaValue;
+
+    // A table is sent as a list if its keys are exactly 1..n
+    int size = lua_rawlen(L, idx);
+    int count = 0;
+    bool numbers = true, integers = true;
+
+    lua_pushnil(L);
+    while (lua_next(L, idx))
+    {
+        count++;
+        lua_pop(L, 1);
+    }
+
+    bool list = (count == size);
+    for (int i = 1; list && i <= size; i++)
+    {
+        lua_rawgeti(L, idx, i);
+        if (lua_isnil(L, -1))
+            list = false;
+        else if (lua_type(L, -1) != LUA_TNUMBER)
+            numbers = integers = false;
+        else if (!lua_isinteger(L, -1))
+            integers = false;
+        lua_pop(L, 1);
+    }
+
+    if (list)
+    {
+        value->set_type(CoreLuaValue::LIST);
+        for (int i = 1; i <= size; i++)
+        {
+            lua_rawgeti(L, idx, i);
+            if (integers)
+                value->add_int_items(lua_tointeger(L, -1));
+            else if (numbers)
+                value->add_number_items(lua_tonumber(L, -1));
+            else
+                encode_lua_value(L, -1, value->add_items(), depth+1);
+            lua_pop(L, 1);
+        }
+        return;
+    }
+
+    value->set_type(CoreLuaValue::MAP);
+    lua_pushnil(L);
+    while (lua_next(L, idx))
+    {
+        encode_lua_value(L, -2, value->add_keys(), depth+1);
+        encode_lua_value(L, -1, value->add_items(), depth+1);
+        lua_pop(L, 1);
+    }
+}
+
+static void encode_lua_value(lua_State *L, int idx, dfproto::CoreLuaValue *value, int depth)
+{
+    using dfproto::CoreLuaValue;
+
+    if (depth > max_lua_value_depth)
+        luaL_error(L, "Lua value nested too deeply");
+    luaL_checkstack(L, 4, "Lua value nested too deeply");
+
+    idx = lua_absindex(L, idx);
+
+    switch (lua_type(L, idx))
+    {
+    case LUA_TNIL:
+        value->set_type(CoreLuaValue::NIL);
+        return;
+    case LUA_TBOOLEAN:
+        value->set_type(CoreLuaValue::BOOLEAN);
+        value->set_bool_value(lua_toboolean(L, idx));
+        return;
+    case LUA_TNUMBER:
+        if (lua_isinteger(L, idx))
+        {
+            value->set_type(CoreLuaValue::INTEGER);
+            value->set_int_value(lua_tointeger(L, idx));
+        }
+        else
+        {
+            value->set_type(CoreLuaValue::NUMBER);
+            value->set_number_value(lua_tonumber(L, idx));
+        }
+        return;
+    case LUA_TTABLE:
+        encode_lua_table(L, idx, value, depth);
+        return;
+    case LUA_TUSERDATA:
+        for (auto &kind : lua_object_kinds)
+        {
+            if (void *ptr = Lua::GetDFObject(L, kind.identity(), idx))
+            {
+                value->set_type(CoreLuaValue::OBJECT);
+                value->set_object_type(kind.name);
+                value->set_object_id(kind.get_id(ptr));
+                return;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+
+    // Strings, and anything else as its string representation
+    size_t len;
+    const char *data = luaL_tolstring(L, idx, &len);
+    value->set_type(CoreLuaValue::STRING);
+    value->set_string_value(std::string(data, len));
+    lua_pop(L, 1);
+}
+
+command_result CoreService::BindLuaFunction(color_ostream &stream,
+                                            const dfproto::CoreBindLuaRequest *in,
+                                            IntMessage *out)
+{
+    auto L = Lua::Core::State;
+    LuaBindData data = { CR_FAILURE, in, out };
+
+    lua_pushcfunction(L, doBindLuaFunction);
+    lua_pushlightuserdata(L, &data);
+
+    if (!Lua::Core::SafeCall(stream, 1, 0))
+        return CR_FAILURE;
+
+    return data.rv;
+}
+
+int CoreService::doBindLuaFunction(lua_State *L)
+{
+    color_ostream &out = *Lua::GetOutput(L);
+    auto &args = *(LuaBindData*)lua_touserdata(L, 1);
+
+    args.rv = push_rpc_function(out, L, args.in->module(), args.in->function());
+    if (args.rv != CR_OK)
+        return 0;
+
+    push_bound_lua_functions(L);
+
+    auto key = std::make_pair(args.in->module(), args.in->function());
+    auto it = bound_lua_handles.find(key);
+    int handle = (it != bound_lua_handles.end()) ? it->second : int(bound_lua_handles.size() + 1);
+
+    lua_pushvalue(L, 1);
+    lua_rawseti(L, -2, handle);
+    bound_lua_handles[key] = handle;
+
+    args.out->set_value(handle);
+    args.rv = CR_OK;
+    return 0;
+}
+
+command_result CoreService::RunLuaValues(color_ostream &stream,
+                                         const dfproto::CoreRunLuaValuesRequest *in,
+                                         dfproto::CoreLuaValueList *out)
+{
+    auto L = Lua::Core::State;
+    LuaValuesData data = { CR_FAILURE, in, out };
+
+    lua_pushcfunction(L, doRunLuaValues);
+    lua_pushlightuserdata(L, &data);
+
+    if (!Lua::Core::SafeCall(stream, 1, 0))
+        return CR_FAILURE;
+
+    return data.rv;
+}
+
+int CoreService::doRunLuaValues(lua_State *L)
+{
+    color_ostream &out = *Lua::GetOutput(L);
+    auto &args = *(LuaValuesData*)lua_touserdata(L, 1);
+
+    // Prepare function and arguments
+    if (args.in->has_handle())
+    {
+        lua_settop(L, 0);
+        push_bound_lua_functions(L);
+        lua_rawgeti(L, 1, args.in->handle());
+        lua_remove(L, 1);
+
+        if (!lua_isfunction(L, 1))
+        {
+            out.printerr("Unknown Lua function handle: %d\n", args.in->handle());
+            args.rv = CR_NOT_FOUND;
+            return 0;
+        }
+    }
+    else
+    {
+        args.rv = push_rpc_function(out, L, args.in->module(), args.in->function());
+        if (args.rv != CR_OK)
+            return 0;
+    }
+
+    luaL_checkstack(L, args.in->arguments_size(), "too many arguments");
+
+    for (int i = 0; i < args.in->arguments_size(); i++)
+        push_lua_value(L, args.in->arguments(i), 0);
+
+    // Call
+    lua_call(L, args.in->arguments_size(), LUA_MULTRET);
+
+    // Store results
+    int nresults = lua_gettop(L);
+
+    for (int i = 1; i <= nresults; i++)
+        encode_lua_value(L, i, args.out->add_values(), 0);
+
+    args.rv = CR_OK;
+    return 0;
+}
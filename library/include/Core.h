@@ -31,13 +31,16 @@ distribution.
 #include <stack>
 #include <map>
 #include <memory>
+#include <unordered_map>
 #include <stdint.h>
 #include "Console.h"
 #include "modules/Graphic.h"
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
+#include <stdexcept>
 #include <thread>
 
 #include "RemoteClient.h"
@@ -93,6 +96,23 @@ namespace DFHack
         SC_UNPAUSED = 8
     };
 
+    /*!
+     * Suspend wait and hold times of one caller, in microseconds.
+     * Histogram bucket 0 counts durations under 1us, and bucket N those
+     * from 2^(N-1) to 2^N us. The last bucket also counts anything longer.
+     * \sa Core::getSuspendStats
+     */
+    struct SuspendStats
+    {
+        std::string caller;
+        bool shared = false;
+        uint64_t count = 0;
+        uint64_t wait_us = 0;
+        uint64_t hold_us = 0;
+        std::vector<uint64_t> wait_histogram;
+        std::vector<uint64_t> hold_histogram;
+    };
+
     class DFHACK_EXPORT StateChangeScript
     {
     public:
@@ -160,6 +180,11 @@ namespace DFHack
         /// returns a named pointer.
         void *GetData(std::string key);
 
+        /// returns how long each caller waited for and held the core suspended
+        std::vector<SuspendStats> getSuspendStats();
+        /// clears the statistics returned by getSuspendStats
+        void resetSuspendStats();
+
         command_result runCommand(color_ostream &out, const std::string &command, std::vector <std::string> &parameters);
         command_result runCommand(color_ostream &out, const std::string &command);
         bool loadScriptFile(color_ostream &out, std::string fname, bool silent = false);
@@ -261,6 +286,13 @@ namespace DFHack
         int8_t modstate;
 
         std::map<int, std::vector<KeyBinding> > key_bindings;
+        // key_bindings by key and modifiers, most recent first. Rebuilt
+        // whenever the bindings change and never modified after that, so
+        // SelectHotkey only needs hotkey_table_mutex to take a reference.
+        typedef std::unordered_map<int64_t, std::vector<KeyBinding> > HotkeyTable;
+        std::shared_ptr<const HotkeyTable> hotkey_table;
+        std::mutex hotkey_table_mutex;
+        void compileKeyBindings();
         std::map<int, bool> hotkey_states;
         std::string hotkey_cmd;
         enum hotkey_set_t {
@@ -302,12 +334,26 @@ namespace DFHack
         std::condition_variable_any CoreWakeup;
         std::atomic<std::thread::id> ownerThread;
         std::atomic<size_t> toolCount;
+        //! Number of SharedCoreSuspender holders. CoreSuspender waits for
+        //! them to finish while holding CoreSuspendMutex, so that no new
+        //! shared holders can start in the meantime.
+        std::mutex SharedSuspendMutex;
+        std::condition_variable SharedSuspendDone;
+        size_t sharedCount;
+        size_t lockShared();
+        void unlockShared();
+        void waitForSharedSuspenders();
+        //! Whether this thread holds a SharedCoreSuspender.
+        static bool holdsSharedSuspend();
+        void recordSuspend(bool shared, std::chrono::steady_clock::duration wait,
+                           std::chrono::steady_clock::duration hold);
         //! \}
 
         friend class CoreService;
         friend class ServerConnection;
         friend class CoreSuspender;
         friend class CoreSuspenderBase;
+        friend class SharedCoreSuspender;
         friend struct CoreSuspendClaimMain;
         friend struct CoreSuspendReleaseMain;
     };
@@ -329,7 +375,13 @@ namespace DFHack
         void lock()
         {
             auto& core = Core::getInstance();
+            // Waiting for CoreSuspendMutex here could deadlock with an
+            // exclusive suspender that is waiting for this shared one.
+            if (Core::holdsSharedSuspend())
+                throw std::logic_error("CoreSuspender taken while holding a SharedCoreSuspender");
             parent_t::lock();
+            if (core.ownerThread.load(std::memory_order_relaxed) != std::this_thread::get_id())
+                core.waitForSharedSuspenders();
             tid = core.ownerThread.exchange(std::this_thread::get_id(),
                     std::memory_order_acquire);
         }
@@ -367,7 +419,8 @@ namespace DFHack
      *   calls Core::Shutdown or Core::~Core.
      * - Other thread request core suspend by atomic incrementation of Core::toolCount
      *   and then locking Core::CoreSuspendMutex. After locking CoreSuspendMutex
-     *   success callers exchange their std::thread::id to Core::ownerThread.
+     *   callers wait until there are no SharedCoreSuspender holders left, and
+     *   then exchange their std::thread::id to Core::ownerThread.
      * - Core::Update() makes sure that queued tools are run when it calls
      *   Core::CoreWakup::wait. The wait keeps Core::CoreSuspendMutex unlocked
      *   and waits until Core::toolCount is reduced back to zero.
@@ -399,13 +452,19 @@ namespace DFHack
         {
             auto& core = Core::getInstance();
             core.toolCount.fetch_add(1, std::memory_order_relaxed);
+            auto start = std::chrono::steady_clock::now();
             parent_t::lock();
+            acquired = std::chrono::steady_clock::now();
+            waited = acquired - start;
         }
 
         void unlock()
         {
             auto& core = Core::getInstance();
+            bool outermost = tid != std::this_thread::get_id();
             parent_t::unlock();
+            if (outermost)
+                core.recordSuspend(false, waited, std::chrono::steady_clock::now() - acquired);
             /* Notify core to continue when all queued tools have completed
              * 0 = None wants to own the core
              * 1+ = There are tools waiting core access
@@ -419,6 +478,72 @@ namespace DFHack
             if (owns_lock())
                 unlock();
         }
+    private:
+        std::chrono::steady_clock::time_point acquired;
+        std::chrono::steady_clock::duration waited;
+    };
+
+    /*!
+     * SharedCoreSuspender suspends DF like CoreSuspender, but any number of
+     * threads can hold it at the same time. DF stays parked at the update
+     * point until all of them are released, and CoreSuspender waits until
+     * they are gone. Holders may only read game data: they must not change
+     * it, use the core Lua state or take a CoreSuspender, which throws
+     * std::logic_error. Nested SharedCoreSuspenders are fine. Library caches
+     * that such readers can reach are either only updated by the exclusive
+     * owner (Core::isSuspended) or locked.
+     */
+    class SharedCoreSuspender {
+    public:
+        SharedCoreSuspender() : locked{false} { lock(); }
+        SharedCoreSuspender(std::defer_lock_t) : locked{false} { }
+        SharedCoreSuspender(const SharedCoreSuspender &) = delete;
+        SharedCoreSuspender &operator=(const SharedCoreSuspender &) = delete;
+
+        void lock()
+        {
+            auto& core = Core::getInstance();
+            auto start = std::chrono::steady_clock::now();
+            outermost = core.lockShared() == 0;
+            locked = true;
+            acquired = std::chrono::steady_clock::now();
+            waited = acquired - start;
+        }
+
+        void unlock()
+        {
+            auto& core = Core::getInstance();
+            locked = false;
+            core.unlockShared();
+            if (outermost)
+                core.recordSuspend(true, waited, std::chrono::steady_clock::now() - acquired);
+        }
+
+        bool owns_lock() const noexcept
+        {
+            return locked;
+        }
+
+        ~SharedCoreSuspender() {
+            if (owns_lock())
+                unlock();
+        }
+    private:
+        bool locked;
+        bool outermost;
+        std::chrono::steady_clock::time_point acquired;
+        std::chrono::steady_clock::duration waited;
+    };
+
+    /*!
+     * Names the suspends made by this thread in Core::getSuspendStats until
+     * it goes out of scope. The name has to outlive the object.
+     */
+    struct DFHACK_EXPORT CoreSuspendCaller {
+        CoreSuspendCaller(const char *name);
+        ~CoreSuspendCaller();
+    private:
+        const char *prev;
     };
 
     /*!
@@ -114,6 +114,40 @@ void print_bits ( T val, ostream& out )
     out << strs.str();
 }
 
+/*
+ * Dense id tables. Large instance vectors sorted by an int32_t id, like
+ * world->units.all, can be registered to get an id -> index table that
+ * binsearch_index (and through it the generated find() methods) consults
+ * before falling back to a binary search. The tables are only updated by
+ * threads that have the core suspended.
+ */
+
+DFHACK_EXPORT bool register_dense_id_vector(const void *vec);
+DFHACK_EXPORT void unregister_dense_id_vector(const void *vec);
+// Tables are only updated when check() returns true; Core sets it to
+// Core::isSuspended.
+DFHACK_EXPORT void set_dense_id_update_check(bool (*check)());
+// Returns the index of key, -1 if it is known not to be in the vector, or
+// -2 if the vector has no usable table and has to be searched.
+DFHACK_EXPORT int dense_id_lookup(const void *vec, size_t key_offset, int32_t key);
+
+const size_t DENSE_ID_MIN_SIZE = 1024;
+
+template <typename CT, typename FT>
+inline int dense_id_index(const std::vector<CT*> &, FT CT::*, FT)
+{
+    return -2;
+}
+
+template <typename CT>
+inline int dense_id_index(const std::vector<CT*> &vec, int32_t CT::*field, int32_t key)
+{
+    if (vec.size() < DENSE_ID_MIN_SIZE)
+        return -2;
+    size_t key_offset = (const char*)&(vec[0]->*field) - (const char*)vec[0];
+    return dense_id_lookup(&vec, key_offset, key);
+}
+
 /*
  * Binary search in vectors.
  */
@@ -169,6 +203,13 @@ int linear_index(const std::vector<CT*> &vec, FT CT::*field, FT key)
 template <typename CT, typename FT>
 int binsearch_index(const std::vector<CT*> &vec, FT CT::*field, FT key, bool exact = true)
 {
+    if (exact)
+    {
+        int idx = dense_id_index(vec, field, key);
+        if (idx != -2)
+            return idx;
+    }
+
     // Returns the index of the value >= the key
     int min = -1, max = (int)vec.size();
     CT *const *p = vec.data();
@@ -401,3 +442,8 @@ DFHACK_EXPORT std::string UTF2DF(const std::string &in);
 DFHACK_EXPORT std::string DF2UTF(const std::string &in);
 DFHACK_EXPORT std::string DF2CONSOLE(const std::string &in);
 DFHACK_EXPORT std::string DF2CONSOLE(DFHack::color_ostream &out, const std::string &in);
+// Same conversions, appending to an existing string instead of making a new one
+DFHACK_EXPORT void appendUTF2DF(std::string &out, const char *in, size_t size);
+DFHACK_EXPORT void appendDF2UTF(std::string &out, const char *in, size_t size);
+// UTF-8 to CP437 never makes a string longer, so it can be done in place
+DFHACK_EXPORT void UTF2DFInPlace(std::string &str);
@@ -51,7 +51,10 @@ namespace  DFHack
         SF_DONT_SUSPEND = 2,
         // The function is considered safe to call from a remote computer.
         // All other functions cannot be allowed for security reasons.
-        SF_ALLOW_REMOTE = 4
+        SF_ALLOW_REMOTE = 4,
+        // The function only reads game data, so suspend the core with a
+        // SharedCoreSuspender and let it run alongside other such functions.
+        SF_SHARED_SUSPEND = 8
     };
 
     class DFHACK_EXPORT ServerFunctionBase : public RPCFunctionBase {
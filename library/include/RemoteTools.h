@@ -136,6 +136,8 @@ namespace DFHack
         CoreSuspender* coreSuspender;
 
         static int doRunLuaFunction(lua_State *L);
+        static int doBindLuaFunction(lua_State *L);
+        static int doRunLuaValues(lua_State *L);
     public:
         CoreService();
         ~CoreService();
@@ -153,5 +155,13 @@ namespace DFHack
         command_result RunLua(color_ostream &stream,
                               const dfproto::CoreRunLuaRequest *in,
                               StringListMessage *out);
+
+        // Typed variant of RunLua; functions can be bound once and then called by handle
+        command_result BindLuaFunction(color_ostream &stream,
+                                       const dfproto::CoreBindLuaRequest *in,
+                                       IntMessage *out);
+        command_result RunLuaValues(color_ostream &stream,
+                                    const dfproto::CoreRunLuaValuesRequest *in,
+                                    dfproto::CoreLuaValueList *out);
     };
 }
@@ -28,6 +28,8 @@ distribution.
 /*
  * DF constructions
  */
+#include <vector>
+
 #include "Export.h"
 #include "DataDefs.h"
 #include "df/construction.h"
@@ -60,6 +62,9 @@ DFHACK_EXPORT uint32_t getCount();
 DFHACK_EXPORT bool copyConstruction (const int32_t index, t_construction &out);
 DFHACK_EXPORT df::construction * getConstruction (const int32_t index);
 DFHACK_EXPORT df::construction * findAtTile(df::coord pos);
+DFHACK_EXPORT bool getConstructionsInBox(std::vector<df::construction*> &constructions,
+    int16_t x1, int16_t y1, int16_t z1,
+    int16_t x2, int16_t y2, int16_t z2);
 
 DFHACK_EXPORT bool designateNew(df::coord pos, df::construction_type type,
                                 df::item_type item = df::item_type::NONE, int mat_index = -1);
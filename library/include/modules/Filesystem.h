@@ -47,7 +47,10 @@ SOFTWARE.
 
 #pragma once
 #include "Export.h"
+#include <functional>
 #include <map>
+#include <string>
+#include <utility>
 #include <vector>
 
 #ifndef _WIN32
@@ -168,5 +171,13 @@ namespace DFHack {
         // paths returned in files
         DFHACK_EXPORT int listdir_recursive (std::string dir, std::map<std::string, bool> &files,
             int depth = 10, bool include_prefix = true);
+        // same as above, but files are returned in directory order (unsorted)
+        DFHACK_EXPORT int listdir_recursive (std::string dir, std::vector<std::pair<std::string, bool> > &files,
+            int depth = 10, bool include_prefix = true);
+        // calls visit(path, is_dir) for each entry as it is read, parents
+        // before their contents. return false from visit to stop early.
+        typedef std::function<bool(const std::string &path, bool is_dir)> listdir_visitor;
+        DFHACK_EXPORT int listdir_recursive (std::string dir, const listdir_visitor &visit,
+            int depth = 10, bool include_prefix = true);
     }
 }
@@ -119,6 +119,21 @@ struct dfh_item
     int16_t wear_level;
 };
 
+/**
+ * Number of clothing items (armor, shoes, helms, gloves and pants) sharing
+ * a type, subtype, material category set and maker race.
+ * \ingroup grp_items
+ */
+struct ClothingCount
+{
+    df::item_type type;
+    int16_t subtype;
+    uint32_t material_mask; // job_material_category bits matched by the material
+    int32_t maker_race;
+    int32_t count;
+    int32_t available; // unworn and not forbidden, dumped, in use, etc.; unowned items only
+};
+
 /**
  * The Items module
  * \ingroup grp_modules
@@ -160,6 +175,10 @@ DFHACK_EXPORT df::unit *getHolderUnit(df::item *item);
 
 /// Returns the true position of the item.
 DFHACK_EXPORT df::coord getPosition(df::item *item);
+/// Returns the true positions of a list of items, walking up each container only once.
+DFHACK_EXPORT void getPositions(const std::vector<df::item*> &items, /*output*/ std::vector<df::coord> *positions);
+/// Returns the owners of a list of items, or NULL for items without one.
+DFHACK_EXPORT void getOwners(const std::vector<df::item*> &items, /*output*/ std::vector<df::unit*> *owners);
 
 /// Returns the title of a codex or "tool", either as the codex title or as the title of the
 /// first page or writing it has that has a non blank title. An empty string is returned if
@@ -202,6 +221,14 @@ DFHACK_EXPORT bool isRouteVehicle(df::item *item);
 /// Checks whether the item is assigned to a squad
 DFHACK_EXPORT bool isSquadEquipment(df::item *item);
 
+/// Collects counts of clothing that nobody owns. Each item is classified once,
+/// and the counts are refreshed at most once per frame, so plugins that manage
+/// clothing orders in the same tick share the work.
+DFHACK_EXPORT void getUnownedClothing(std::vector<ClothingCount> *counts);
+/// Collects counts of the clothing owned by the unit. Only the unit's own
+/// owned_items are looked at.
+DFHACK_EXPORT void getOwnedClothing(df::unit *unit, std::vector<ClothingCount> *counts);
+
 }
 }
 
@@ -41,6 +41,7 @@ namespace df
     struct job;
     struct job_item;
     struct job_item_filter;
+    struct manager_order;
     struct building;
     struct unit;
 }
@@ -106,6 +107,42 @@ namespace DFHack
                                               int mat_index,
                                               df::item_type itype);
         DFHACK_EXPORT std::string getName(df::job *job);
+
+        // Fields of a manager order that make up its job signature.
+        enum OrderSignatureField {
+            ORDER_JOB_TYPE = 1,
+            ORDER_REACTION_NAME = 2,
+            ORDER_ITEM_TYPE = 4,
+            ORDER_ITEM_SUBTYPE = 8,
+            ORDER_MAT_TYPE = 16,
+            ORDER_MAT_INDEX = 32,
+            ORDER_ITEM_CATEGORY = 64,
+            ORDER_MATERIAL_CATEGORY = 128,
+            ORDER_HIST_FIGURE = 256,
+            ORDER_SIGNATURE_ALL = 511
+        };
+
+        // The manager orders whose signature fields match those of the pattern.
+        // Lookups go through an index that is rebuilt when the order list changes.
+        DFHACK_EXPORT void findOrders(std::vector<df::manager_order*> *orders,
+                                      const df::manager_order *pattern,
+                                      int fields = ORDER_SIGNATURE_ALL);
+        // Total amount_left of the orders matching the pattern.
+        DFHACK_EXPORT int getOrderAmountLeft(const df::manager_order *pattern,
+                                             int fields = ORDER_SIGNATURE_ALL);
+        // One order and the total amount_left for each distinct signature.
+        DFHACK_EXPORT void getOrderGroups(std::vector<std::pair<df::manager_order*, int> > *groups,
+                                          int fields = ORDER_SIGNATURE_ALL);
+
+        // Makes sure the orders matching each pattern have at least the given
+        // amount left in total. Missing amounts are added to the last matching
+        // order, or to a new order with the signature of the pattern if there is
+        // none or add_new is true. Returns the number of orders created.
+        DFHACK_EXPORT int ensureOrderAmounts(const std::vector<df::manager_order*> &patterns,
+                                             const std::vector<int> &amounts,
+                                             int fields = ORDER_SIGNATURE_ALL,
+                                             bool add_new = false,
+                                             std::vector<df::manager_order*> *created = NULL);
     }
 
     DFHACK_EXPORT bool operator== (const df::job_item &a, const df::job_item &b);
@@ -60,9 +60,13 @@ DFHACK_EXPORT void debug_print(color_ostream &out);
 
 // remove this material from the exclusion list if it is in it
 DFHACK_EXPORT void allowPlantSeedCookery(t_materialIndex materialIndex);
+// same for several materials, in one pass over the exclusion list
+DFHACK_EXPORT void allowPlantSeedCookery(const std::vector<t_materialIndex> &materialIndices);
 
 // add this material to the exclusion list, if it is not already in it
 DFHACK_EXPORT void denyPlantSeedCookery(t_materialIndex materialIndex);
+// same for several materials
+DFHACK_EXPORT void denyPlantSeedCookery(const std::vector<t_materialIndex> &materialIndices);
 
 // fills a map with info from the limit info storage entries in the exclusion list
 DFHACK_EXPORT void fillWatchMap(std::map<t_materialIndex, unsigned int>& watchMap);
@@ -93,5 +97,22 @@ DFHACK_EXPORT bool removeExclusion(df::kitchen_exc_type type,
     df::item_type item_type, int16_t item_subtype,
     int16_t mat_type, int32_t mat_index);
 
+// One entry of the exclusion list, for the batch functions below.
+struct Exclusion
+{
+    df::kitchen_exc_type type;
+    df::item_type item_type;
+    int16_t item_subtype;
+    int16_t mat_type;
+    int32_t mat_index;
+};
+
+// Adds the exclusions that are not already present. Returns the number added.
+DFHACK_EXPORT size_t addExclusions(const std::vector<Exclusion> &exclusions);
+
+// Removes every occurrence of the given exclusions in one pass over the list.
+// Returns the number of entries removed.
+DFHACK_EXPORT size_t removeExclusions(const std::vector<Exclusion> &exclusions);
+
 }
 }
@@ -39,6 +39,7 @@ distribution.
 #include "df/inclusion_type.h"
 
 #include <bitset>
+#include <memory>
 
 namespace df {
     struct world_region_details;
@@ -66,6 +67,20 @@ struct BiomeInfo {
     int16_t layer_stone[MAX_LAYERS];
 };
 
+/*
+ * Geology of the map and the regions around it. It is built once per map
+ * load and shared, read-only, by all the map caches created on that map.
+ * Code that edits the geology layers must call invalidate() afterwards.
+ */
+struct GeologyInfo {
+    bool valid;
+    std::vector<BiomeInfo> biomes;
+
+    static std::shared_ptr<const GeologyInfo> get();
+    // Drops the shared copy; done automatically on world and map load/unload.
+    static void invalidate();
+};
+
 typedef uint8_t t_veintype[16][16];
 typedef df::tiletype t_tilearr[16][16];
 
@@ -87,7 +102,7 @@ public:
     t_veintype veintype;
     t_blockmaterials veinmats;
     t_blockmaterials grass;
-    std::map<df::coord,df::plant*> plants;
+    df::plant *plants[16][16];
 
     df::feature_init *global_feature;
     df::feature_init *local_feature;
@@ -622,9 +637,9 @@ class DFHACK_EXPORT MapCache
     uint32_t maxTileY() { return y_tmax; }
     uint32_t maxZ() { return z_max; }
 
-    size_t getBiomeCount() { return biomes.size(); }
+    size_t getBiomeCount() { return geology->biomes.size(); }
     const BiomeInfo &getBiomeByIndex(unsigned idx) {
-        return (idx < biomes.size()) ? biomes[idx] : biome_stub;
+        return (idx < geology->biomes.size()) ? geology->biomes[idx] : biome_stub;
     }
 
 private:
@@ -634,14 +649,12 @@ private:
     static const BiomeInfo biome_stub;
 
     bool valid;
-    bool validgeo;
     uint32_t x_bmax;
     uint32_t y_bmax;
     uint32_t x_tmax;
     uint32_t y_tmax;
     uint32_t z_max;
-    std::vector<BiomeInfo> biomes;
-    std::map<df::coord2d, df::world_region_details*> region_details;
+    std::shared_ptr<const GeologyInfo> geology;
     std::map<DFCoord, Block *> blocks;
 };
 }
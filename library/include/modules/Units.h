@@ -77,6 +77,9 @@ DFHACK_EXPORT bool getUnitsInBox(std::vector<df::unit*> &units,
     int16_t x1, int16_t y1, int16_t z1,
     int16_t x2, int16_t y2, int16_t z2);
 
+// Citizens among the active units, see isCitizen.
+DFHACK_EXPORT bool getCitizens(std::vector<df::unit*> &citizens);
+
 DFHACK_EXPORT int32_t findIndexById(int32_t id);
 
 /// Returns the true position of the unit (non-trivial in case of caged).
@@ -386,6 +386,12 @@ function dfhack.random:__tostring()
     return "<random generator>"
 end
 
+dfhack.searchindex.__index = dfhack.searchindex
+
+function dfhack.searchindex:__tostring()
+    return "<search index: "..self:size().." keys>"
+end
+
 dfhack.penarray.__index = dfhack.penarray
 
 function dfhack.penarray.__tostring()
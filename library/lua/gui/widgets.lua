@@ -495,6 +495,13 @@ function List:setChoices(choices, selected)
     self:setSelected(selected)
 end
 
+-- Like setChoices, for choices that have already been through it, e.g. a
+-- subset of the choices of another list. They are used as they are.
+function List:setParsedChoices(choices, selected)
+    self.choices = choices or {}
+    self:setSelected(selected)
+end
+
 function List:setSelected(selected)
     self.selected = selected or self.selected or 1
     self:moveCursor(0, true)
@@ -762,6 +769,8 @@ function FilteredList:setChoices(choices, pos)
     self.edit.text = ''
     self.list:setChoices(choices, pos)
     self.choices = self.list.choices
+    self.choice_index = nil
+    self.search_index = nil
     self.not_found.visible = (#choices == 0)
 end
 
@@ -796,6 +805,34 @@ function FilteredList:getFilter()
     return self.edit.text, self.list.choices
 end
 
+local function get_search_key(choice)
+    local key = choice.search_key or choice.text
+    if type(key) == 'table' then
+        local parts = {}
+        for _,v in ipairs(key) do
+            if type(v) == 'table' then
+                v = v.text
+            end
+            if type(v) == 'string' then
+                table.insert(parts, v)
+            end
+        end
+        key = table.concat(parts, ' ')
+    end
+    return key
+end
+
+function FilteredList:getSearchIndex()
+    if not self.search_index then
+        local keys = {}
+        for i,v in ipairs(self.choices) do
+            keys[i] = get_search_key(v)
+        end
+        self.search_index = dfhack.searchindex.new(keys)
+    end
+    return self.search_index
+end
+
 function FilteredList:setFilter(filter, pos)
     local choices = self.choices
     local cidx = nil
@@ -804,35 +841,15 @@ function FilteredList:setFilter(filter, pos)
     self.edit.text = filter
 
     if filter ~= '' then
-        local tokens = utils.split_string(filter, ' ')
-        local ipos = pos
-
+        cidx, pos = self:getSearchIndex():filter(filter, pos)
         choices = {}
-        cidx = {}
-        pos = nil
-
-        for i,v in ipairs(self.choices) do
-            local ok = true
-            local search_key = v.search_key or v.text
-            for _,key in ipairs(tokens) do
-                if key ~= '' and
-                        not string.match(search_key, '%f[^%s%p\x00]'..key) then
-                    ok = false
-                    break
-                end
-            end
-            if ok then
-                table.insert(choices, v)
-                cidx[#choices] = i
-                if ipos == i then
-                    pos = #choices
-                end
-            end
+        for i,idx in ipairs(cidx) do
+            choices[i] = self.choices[idx]
         end
     end
 
     self.choice_index = cidx
-    self.list:setChoices(choices, pos)
+    self.list:setParsedChoices(choices, pos)
     self.not_found.visible = (#choices == 0)
 end
 
@@ -56,50 +56,70 @@ end
 
 -- Search methods
 
-function CheckedArray:find(data,sidx,eidx,reverse)
+-- Number of indices collected per call into the native scanners
+local SCAN_BATCH = 65536
+
+local function with_index_buffer(count, fn)
+    return dfhack.with_temp_object(df.new('int64_t', math.max(count, 1)), fn)
+end
+
+function CheckedArray:find_all(data,sidx,eidx,reverse,max_hits)
     local dcnt = #data
     sidx = math.max(0, sidx or 0)
     eidx = math.min(self.count, eidx or self.count)
-    if (eidx - sidx) >= dcnt and dcnt > 0 then
-        return dfhack.with_temp_object(
-            df.new(self.type, dcnt),
-            function(buffer)
-                for i = 1,dcnt do
-                    buffer[i-1] = data[i]
-                end
-                local cnt = eidx - sidx - dcnt
-                local step = self.esize
-                local sptr = self.start + sidx*step
-                local ksize = dcnt*step
-                if reverse then
-                    local idx, addr = dfhack.internal.memscan(sptr + cnt*step, cnt, -step, buffer, ksize)
-                    if idx then
-                        return sidx + cnt - idx, addr
+    local rv = {}
+    if (eidx - sidx) < dcnt or dcnt <= 0 then
+        return rv
+    end
+    local cnt = eidx - sidx - dcnt + 1
+    max_hits = math.min(max_hits or cnt, cnt)
+    if max_hits <= 0 then
+        return rv
+    end
+    local step = self.esize
+    local sptr = self.start + sidx*step
+    if reverse then
+        sptr = sptr + (cnt-1)*step
+        step = -step
+    end
+    return dfhack.with_temp_object(
+        df.new(self.type, dcnt),
+        function(needle)
+            for i = 1,dcnt do
+                needle[i-1] = data[i]
+            end
+            return with_index_buffer(math.min(max_hits, SCAN_BATCH), function(buffer)
+                local done = 0
+                while done < cnt and #rv < max_hits do
+                    local want = math.min(max_hits - #rv, SCAN_BATCH)
+                    local n = dfhack.internal.memscanAll(sptr + done*step, cnt - done, step,
+                                                         needle, dcnt*self.esize, buffer, want)
+                    for i = 0,n-1 do
+                        local k = done + buffer[i]
+                        rv[#rv+1] = reverse and (sidx + cnt - 1 - k) or (sidx + k)
                     end
-                else
-                    local idx, addr = dfhack.internal.memscan(sptr, cnt, step, buffer, ksize)
-                    if idx then
-                        return sidx + idx, addr
+                    if n < want then
+                        break
                     end
+                    done = done + buffer[n-1] + 1
                 end
-            end
-        )
+                return rv
+            end)
+        end
+    )
+end
+function CheckedArray:find(data,sidx,eidx,reverse)
+    local idx = self:find_all(data,sidx,eidx,reverse,1)[1]
+    if idx then
+        return idx, self:idx2addr(idx)
     end
 end
 function CheckedArray:find_one(data,sidx,eidx,reverse)
-    local idx, addr = self:find(data,sidx,eidx,reverse)
-    if idx then
-        -- Verify this is the only match
-        if reverse then
-            eidx = idx+#data-1
-        else
-            sidx = idx+1
-        end
-        if self:find(data,sidx,eidx,reverse) then
-            return nil
-        end
+    local found = self:find_all(data,sidx,eidx,reverse,2)
+    -- Verify this is the only match
+    if #found == 1 then
+        return found[1], self:idx2addr(found[1])
     end
-    return idx, addr
 end
 function CheckedArray:list_changes(old_arr,old_val,new_val,delta)
     if old_arr.type ~= self.type or old_arr.count ~= self.count then
@@ -110,37 +130,44 @@ function CheckedArray:list_changes(old_arr,old_val,new_val,delta)
     local nptr = self.start
     local esize = self.esize
     local rv
-    local sidx = 0
-    while true do
-        local idx = dfhack.internal.diffscan(optr, nptr, sidx, eidx, esize, old_val, new_val, delta)
-        if not idx then
-            break
+    with_index_buffer(SCAN_BATCH, function(buffer)
+        local sidx = 0
+        while sidx < eidx do
+            local n = dfhack.internal.diffscanAll(optr, nptr, sidx, eidx, esize,
+                                                  old_val, new_val, delta, buffer, SCAN_BATCH)
+            if n > 0 then
+                rv = rv or {}
+                for i = 0,n-1 do
+                    rv[#rv+1] = buffer[i]
+                end
+            end
+            if n < SCAN_BATCH then
+                break
+            end
+            sidx = buffer[n-1]+1
         end
-        rv = rv or {}
-        rv[#rv+1] = idx
-        sidx = idx+1
-    end
+    end)
     return rv
 end
 function CheckedArray:filter_changes(prev_list,old_arr,old_val,new_val,delta)
     if old_arr.type ~= self.type or old_arr.count ~= self.count then
         error('Incompatible arrays')
     end
-    local eidx = self.count
-    local optr = old_arr.start
-    local nptr = self.start
-    local esize = self.esize
+    local cnt = #prev_list
     local rv
-    for i=1,#prev_list do
-        local idx = prev_list[i]
-        if idx < 0 or idx >= eidx then
-            error('Index out of bounds: '..idx)
+    with_index_buffer(cnt, function(buffer)
+        for i=1,cnt do
+            buffer[i-1] = prev_list[i]
         end
-        if dfhack.internal.diffscan(optr, nptr, idx, idx+1, esize, old_val, new_val, delta) then
-            rv = rv or {}
-            rv[#rv+1] = idx
+        local n = dfhack.internal.diffscanFilter(old_arr.start, self.start, buffer, cnt, self.count,
+                                                 self.esize, old_val, new_val, delta, buffer)
+        if n > 0 then
+            rv = {}
+            for i = 0,n-1 do
+                rv[i+1] = buffer[i]
+            end
         end
-    end
+    end)
     return rv
 end
 
@@ -336,6 +336,9 @@ function sort_vector(vector,field,cmp)
         if vector._kind ~= 'container' then
             error('Container expected: '..tostring(vector))
         end
+        if dfhack.internal.vectorSort(vector, field, cmp ~= compare and cmp or nil) then
+            return vector
+        end
         local items = clone(vector, true)
         table.sort(items, scmp)
         vector:assign(items)
@@ -350,6 +353,13 @@ end
 function linear_index(vector,key,field)
     local min,max
     if df.isvalid(vector) then
+        local i = dfhack.internal.vectorLinearIndex(vector, key, field)
+        if i then
+            if i < 0 then
+                return nil
+            end
+            return i, vector[i]
+        end
         min,max = 0,#vector-1
     else
         min,max = 1,#vector
@@ -375,6 +385,14 @@ end
 
 -- Binary search in a vector or lua table
 function binsearch(vector,key,field,cmp,min,max)
+    if (cmp == nil or cmp == compare) and df.isvalid(vector) == 'ref' then
+        local found, pos = dfhack.internal.vectorBinsearch(vector, key, field, min, max)
+        if found then
+            return vector[pos], true, pos
+        elseif found ~= nil then
+            return nil, false, pos
+        end
+    end
     if not(min and max) then
         if df.isvalid(vector) then
             min = -1
@@ -28,6 +28,7 @@ distribution.
 #include <string>
 #include <vector>
 #include <map>
+#include <algorithm>
 using namespace std;
 
 
@@ -68,15 +69,54 @@ df::construction * Constructions::getConstruction(const int32_t index)
     return world->constructions[index];
 }
 
+// world->constructions is kept sorted by position, so lookups can binary
+// search it directly and never go stale.
+static bool constructionPosLess(const df::construction *a, const df::coord &pos)
+{
+    return a->pos < pos;
+}
+
 df::construction * Constructions::findAtTile(df::coord pos)
 {
-    for (auto it = world->constructions.begin(); it != world->constructions.end(); ++it) {
-        if ((*it)->pos == pos)
-            return *it;
-    }
+    if (!world)
+        return NULL;
+
+    auto &all = world->constructions;
+    auto it = lower_bound(all.begin(), all.end(), pos, constructionPosLess);
+    if (it != all.end() && (*it)->pos == pos)
+        return *it;
     return NULL;
 }
 
+bool Constructions::getConstructionsInBox(std::vector<df::construction*> &constructions,
+    int16_t x1, int16_t y1, int16_t z1,
+    int16_t x2, int16_t y2, int16_t z2)
+{
+    constructions.clear();
+    if (!world)
+        return false;
+
+    if (x1 > x2) swap(x1, x2);
+    if (y1 > y2) swap(y1, y2);
+    if (z1 > z2) swap(z1, z2);
+
+    // Each column of the box is one run of the vector, and going through the
+    // columns in order reports them in vector order, like a linear scan would.
+    auto &all = world->constructions;
+    int x_end = std::min<int>(x2, world->map.x_count_block * 16 - 1);
+    for (int x = std::max<int>(x1, 0); x <= x_end; x++)
+    {
+        auto it = lower_bound(all.begin(), all.end(), df::coord(x, y1, z1), constructionPosLess);
+        for (; it != all.end() && (*it)->pos.x == x && (*it)->pos.y <= y2; ++it)
+        {
+            auto &pos = (*it)->pos;
+            if (pos.z >= z1 && pos.z <= z2)
+                constructions.push_back(*it);
+        }
+    }
+    return true;
+}
+
 bool Constructions::copyConstruction(const int32_t index, t_construction &out)
 {
     if (uint32_t(index) >= getCount())
@@ -172,11 +172,22 @@ static int32_t nextBuilding;
 static unordered_set<int32_t> buildings;
 
 //construction
-static unordered_map<df::coord, df::construction> constructions;
+//copies of world->constructions, in the same (position) order
+static vector<df::construction> constructions;
 static bool gameLoaded;
 
 //syndrome
 static int32_t lastSyndromeTime;
+struct SyndromeWatch {
+    size_t count;
+    df::unit_syndrome* last;
+    //a new syndrome can be allocated where the last one was, so its type and start time are kept too
+    int32_t lastType;
+    int32_t lastTime;
+    int32_t generation;
+};
+static unordered_map<int32_t, SyndromeWatch> syndromeWatch;
+static int32_t syndromeWatchGeneration;
 
 //invasion
 static int32_t nextInvasion;
@@ -217,6 +228,7 @@ void DFHack::EventManager::onStateChange(color_ostream& out, state_change_event
         livingUnits.clear();
         buildings.clear();
         constructions.clear();
+        syndromeWatch.clear();
         equipmentLog.clear();
 
         Buildings::clearBuildings(out);
@@ -269,14 +281,18 @@ void DFHack::EventManager::onStateChange(color_ostream& out, state_change_event
                     out.print("EventManager.onLoad null position of construction.\n");
                 continue;
             }
-            constructions[constr->pos] = *constr;
+            constructions.push_back(*constr);
         }
+        std::stable_sort(constructions.begin(), constructions.end(), [](const df::construction& a, const df::construction& b) {
+            return a.pos < b.pos;
+        });
         for ( size_t a = 0; a < df::global::world->buildings.all.size(); a++ ) {
             df::building* b = df::global::world->buildings.all[a];
             Buildings::updateBuildings(out, (void*)intptr_t(b->id));
             buildings.insert(b->id);
         }
         lastSyndromeTime = -1;
+        syndromeWatch.clear();
         for ( size_t a = 0; a < df::global::world->units.all.size(); a++ ) {
             df::unit* unit = df::global::world->units.all[a];
             for ( size_t b = 0; b < unit->syndromes.active.size(); b++ ) {
@@ -631,39 +647,68 @@ static void manageBuildingEvent(color_ostream& out) {
     }
 }
 
+static bool constructionPosLess(const df::construction* a, const df::construction* b) {
+    return a->pos < b->pos;
+}
+
 static void manageConstructionEvent(color_ostream& out) {
     if (!df::global::world)
         return;
-    //unordered_set<df::construction*> constructionsNow(df::global::world->constructions.begin(), df::global::world->constructions.end());
 
-    multimap<Plugin*,EventHandler> copy(handlers[EventType::CONSTRUCTION].begin(), handlers[EventType::CONSTRUCTION].end());
-    for ( auto a = constructions.begin(); a != constructions.end(); ) {
-        df::construction& construction = (*a).second;
-        if ( df::construction::find(construction.pos) != NULL ) {
-            a++;
-            continue;
+    //world->constructions is kept sorted by position (df::construction::find relies on it), so it can be diffed against the previous copy in one pass
+    const vector<df::construction*>* current = &df::global::world->constructions;
+    vector<df::construction*> sorted;
+    if ( !std::is_sorted(current->begin(), current->end(), constructionPosLess) ) {
+        sorted = *current;
+        std::stable_sort(sorted.begin(), sorted.end(), constructionPosLess);
+        current = &sorted;
+    }
+
+    vector<df::construction> removed;
+    vector<df::construction*> created;
+    size_t a = 0, b = 0;
+    while ( a < constructions.size() || b < current->size() ) {
+        if ( b == current->size() || (a < constructions.size() && constructions[a].pos < (*current)[b]->pos) ) {
+            removed.push_back(constructions[a++]);
+        } else if ( a == constructions.size() || (*current)[b]->pos < constructions[a].pos ) {
+            created.push_back((*current)[b++]);
+        } else {
+            constructions[a++] = *(*current)[b++];
         }
+    }
+    if ( removed.empty() && created.empty() )
+        return;
+
+    constructions.clear();
+    constructions.reserve(current->size());
+    for ( auto c = current->begin(); c != current->end(); c++ )
+        constructions.push_back(**c);
+
+    multimap<Plugin*,EventHandler> copy(handlers[EventType::CONSTRUCTION].begin(), handlers[EventType::CONSTRUCTION].end());
+    for ( auto c = removed.begin(); c != removed.end(); c++ ) {
         //construction removed
-        //out.print("Removed construction (%d,%d,%d)\n", construction.pos.x,construction.pos.y,construction.pos.z);
-        for ( auto b = copy.begin(); b != copy.end(); b++ ) {
-            EventHandler handle = (*b).second;
-            handle.eventHandler(out, (void*)&construction);
+        //out.print("Removed construction (%d,%d,%d)\n", c->pos.x,c->pos.y,c->pos.z);
+        for ( auto h = copy.begin(); h != copy.end(); h++ ) {
+            EventHandler handle = (*h).second;
+            handle.eventHandler(out, (void*)&(*c));
         }
-        a = constructions.erase(a);
     }
 
-    //for ( auto a = constructionsNow.begin(); a != constructionsNow.end(); a++ ) {
-    for ( auto a = df::global::world->constructions.begin(); a != df::global::world->constructions.end(); a++ ) {
-        df::construction* construction = *a;
-        bool b = constructions.find(construction->pos) != constructions.end();
-        constructions[construction->pos] = *construction;
-        if ( b )
-            continue;
+    //created constructions are reported in world->constructions order
+    if ( current == &sorted ) {
+        unordered_set<df::construction*> isNew(created.begin(), created.end());
+        created.clear();
+        for ( auto c = df::global::world->constructions.begin(); c != df::global::world->constructions.end(); c++ ) {
+            if ( isNew.count(*c) )
+                created.push_back(*c);
+        }
+    }
+    for ( auto c = created.begin(); c != created.end(); c++ ) {
         //construction created
-        //out.print("Created construction (%d,%d,%d)\n", construction->pos.x,construction->pos.y,construction->pos.z);
-        for ( auto b = copy.begin(); b != copy.end(); b++ ) {
-            EventHandler handle = (*b).second;
-            handle.eventHandler(out, (void*)construction);
+        //out.print("Created construction (%d,%d,%d)\n", (*c)->pos.x,(*c)->pos.y,(*c)->pos.z);
+        for ( auto h = copy.begin(); h != copy.end(); h++ ) {
+            EventHandler handle = (*h).second;
+            handle.eventHandler(out, (void*)*c);
         }
     }
 }
@@ -672,15 +717,27 @@ static void manageSyndromeEvent(color_ostream& out) {
     if (!df::global::world)
         return;
     multimap<Plugin*,EventHandler> copy(handlers[EventType::SYNDROME].begin(), handlers[EventType::SYNDROME].end());
-    int32_t highestTime = -1;
-    for ( auto a = df::global::world->units.all.begin(); a != df::global::world->units.all.end(); a++ ) {
+    //syndromes are only acquired by active units and are appended to their list, so a unit only needs to be rescanned when the size or the last entry of its list changed
+    syndromeWatchGeneration++;
+    int32_t highestTime = lastSyndromeTime;
+    for ( auto a = df::global::world->units.active.begin(); a != df::global::world->units.active.end(); a++ ) {
         df::unit* unit = *a;
-/*
-        if ( unit->flags1.bits.inactive )
-            continue;
-*/
-        for ( size_t b = 0; b < unit->syndromes.active.size(); b++ ) {
-            df::unit_syndrome* syndrome = unit->syndromes.active[b];
+        auto& syndromes = unit->syndromes.active;
+        df::unit_syndrome* last = syndromes.empty() ? NULL : syndromes.back();
+        int32_t lastType = last ? last->type : -1;
+        int32_t lastTime = last ? last->year*ticksPerYear + last->year_time : -1;
+        SyndromeWatch fresh = { syndromes.size(), last, lastType, lastTime, syndromeWatchGeneration };
+        auto watch = syndromeWatch.insert(make_pair(unit->id, fresh));
+        if ( !watch.second ) {
+            SyndromeWatch& w = watch.first->second;
+            w.generation = syndromeWatchGeneration;
+            if ( w.count == syndromes.size() && w.last == last && w.lastType == lastType && w.lastTime == lastTime )
+                continue;
+            w = fresh;
+        }
+
+        for ( size_t b = 0; b < syndromes.size(); b++ ) {
+            df::unit_syndrome* syndrome = syndromes[b];
             int32_t startTime = syndrome->year*ticksPerYear + syndrome->year_time;
             if ( startTime > highestTime )
                 highestTime = startTime;
@@ -695,6 +752,16 @@ static void manageSyndromeEvent(color_ostream& out) {
         }
     }
     lastSyndromeTime = highestTime;
+
+    //forget units that are no longer active; they are rescanned if they come back
+    if ( syndromeWatch.size() > df::global::world->units.active.size() ) {
+        for ( auto a = syndromeWatch.begin(); a != syndromeWatch.end(); ) {
+            if ( a->second.generation != syndromeWatchGeneration )
+                a = syndromeWatch.erase(a);
+            else
+                a++;
+        }
+    }
 }
 
 static void manageInvasionEvent(color_ostream& out) {
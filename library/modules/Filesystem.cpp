@@ -229,46 +229,147 @@ int Filesystem::listdir (std::string dir, std::vector<std::string> &files)
     return 0;
 }
 
-// prefix is the top-level dir where we started recursing
-// path is the relative path under the prefix; must be empty or end in a '/'
-// files is the output list of files and directories (bool == true for dir)
+// Walks a directory tree, reporting each entry to a visitor. The directory
+// type from readdir is used where available so that most entries don't need
+// a stat, and subdirectories are opened relative to their parent.
+namespace {
+    struct listdir_walker
+    {
+        const Filesystem::listdir_visitor &visit;
+        // path reported to the visitor; the directory being read when
+        // inside walk(), always empty or ending in a '/'
+        std::string name;
+#ifdef _WIN32
+        // full path of the directory being read, for opening subdirectories
+        std::string full;
+#endif
+        bool stopped;
+
+        listdir_walker(const Filesystem::listdir_visitor &visit)
+            : visit(visit), stopped(false)
+        {}
+
+        bool is_dir(DIR *dp, struct dirent *ent)
+        {
+            if (ent->d_type == DT_DIR)
+                return true;
+#ifdef _WIN32
+            if (ent->d_type != DT_UNKNOWN)
+                return false;
+            return Filesystem::isdir(full + ent->d_name);
+#else
+            if (ent->d_type != DT_UNKNOWN && ent->d_type != DT_LNK)
+                return false;
+            // follow symlinks, like Filesystem::isdir
+            STAT_STRUCT info;
+            return fstatat(dirfd(dp), ent->d_name, &info, 0) == 0 && S_ISDIR(info.st_mode);
+#endif
+        }
+
+        DIR *open_subdir(DIR *dp, const char *dname)
+        {
+#ifdef _WIN32
+            return opendir((full + dname + "/").c_str());
+#else
+            int fd = openat(dirfd(dp), dname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd < 0)
+                return NULL;
+            DIR *subdir = fdopendir(fd);
+            if (!subdir)
+            {
+                int err = errno;
+                ::close(fd);
+                errno = err;
+            }
+            return subdir;
+#endif
+        }
+
+        // reads and closes dp. depth is the remaining dir depth to recurse
+        // into; returns -1 if we run out of depth before we're done.
+        int walk(DIR *dp, int depth)
+        {
+            int err = 0;
+            struct dirent *ent;
+            while (!err && !stopped && (ent = readdir(dp)) != NULL)
+            {
+                const char *dname = ent->d_name;
+                if (dname[0] == '.' && (!dname[1] || (dname[1] == '.' && !dname[2])))
+                    continue;
+
+                bool dir = is_dir(dp, ent);
+                size_t name_len = name.size();
+                name += dname;
+
+                if (!visit(name, dir))
+                    stopped = true;
+                else if (dir && depth <= 0)
+                    err = -1;
+                else if (dir)
+                {
+                    DIR *subdir = open_subdir(dp, dname);
+                    if (!subdir)
+                        err = errno;
+                    else
+                    {
+                        name += '/';
+#ifdef _WIN32
+                        size_t full_len = full.size();
+                        full.append(dname).append("/");
+#endif
+                        err = walk(subdir, depth - 1);
+#ifdef _WIN32
+                        full.resize(full_len);
+#endif
+                    }
+                }
+
+                name.resize(name_len);
+            }
+            closedir(dp);
+            return err;
+        }
+    };
+}
+
+// dir is the top-level dir where we start recursing
 // depth is the remaining dir depth to recurse into. function returns -1 if
 //   we haven't finished recursing when we run out of depth.
 // include_prefix controls whether the directory where we started recursing is
-//   included in the filenames returned in files.
-static int listdir_recursive_impl (std::string prefix, std::string path,
-    std::map<std::string, bool> &files, int depth, bool include_prefix)
+//   included in the filenames passed to visit.
+int Filesystem::listdir_recursive (std::string dir, const listdir_visitor &visit,
+    int depth /* = 10 */, bool include_prefix /* = true */)
 {
     if (depth < 0)
         return -1;
-    std::string prefixed_path = prefix + "/" + path;
-    std::vector<std::string> curdir_files;
-    int err = Filesystem::listdir(prefixed_path, curdir_files);
-    if (err)
-        return err;
-    for (auto file = curdir_files.begin(); file != curdir_files.end(); ++file)
-    {
-        if (*file == "." || *file == "..")
-            continue;
-        std::string prefixed_file = prefixed_path + *file;
-        std::string path_file = path + *file;
-        if (Filesystem::isdir(prefixed_file))
-        {
-            files.insert(std::pair<std::string, bool>(include_prefix ? prefixed_file : path_file, true));
-            err = listdir_recursive_impl(prefix, path_file + "/", files, depth - 1, include_prefix);
-            if (err)
-                return err;
-        }
-        else
-        {
-            files.insert(std::pair<std::string, bool>(include_prefix ? prefixed_file : path_file, false));
-        }
-    }
-    return 0;
+    std::string prefixed_path = dir + "/";
+    DIR *dp = opendir(prefixed_path.c_str());
+    if (!dp)
+        return errno;
+
+    listdir_walker walker(visit);
+    if (include_prefix)
+        walker.name = prefixed_path;
+#ifdef _WIN32
+    walker.full = prefixed_path;
+#endif
+    return walker.walk(dp, depth);
 }
 
 int Filesystem::listdir_recursive (std::string dir, std::map<std::string, bool> &files,
     int depth /* = 10 */, bool include_prefix /* = true */)
 {
-    return listdir_recursive_impl(dir, "", files, depth, include_prefix);
+    return listdir_recursive(dir, [&](const std::string &path, bool is_dir) {
+        files.insert(std::pair<std::string, bool>(path, is_dir));
+        return true;
+    }, depth, include_prefix);
+}
+
+int Filesystem::listdir_recursive (std::string dir, std::vector<std::pair<std::string, bool> > &files,
+    int depth /* = 10 */, bool include_prefix /* = true */)
+{
+    return listdir_recursive(dir, [&](const std::string &path, bool is_dir) {
+        files.push_back(std::pair<std::string, bool>(path, is_dir));
+        return true;
+    }, depth, include_prefix);
 }
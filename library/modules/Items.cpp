@@ -32,10 +32,13 @@ distribution.
 
 #include <cstdio>
 #include <map>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <set>
+#include <tuple>
+#include <unordered_map>
 using namespace std;
 
 #include "ModuleFactory.h"
@@ -55,6 +58,7 @@ using namespace std;
 #include "df/general_ref_contained_in_itemst.h"
 #include "df/general_ref_contains_itemst.h"
 #include "df/general_ref_projectile.h"
+#include "df/general_ref_unit.h"
 #include "df/general_ref_unit_itemownerst.h"
 #include "df/general_ref_unit_holderst.h"
 #include "df/historical_entity.h"
@@ -79,7 +83,9 @@ using namespace std;
 #include "df/itemimprovement.h"
 #include "df/itemimprovement_pagesst.h"
 #include "df/itemimprovement_writingst.h"
+#include "df/items_other_id.h"
 #include "df/job_item.h"
+#include "df/job_material_category.h"
 #include "df/mandate.h"
 #include "df/map_block.h"
 #include "df/proj_itemst.h"
@@ -537,6 +543,8 @@ df::specific_ref *Items::getSpecificRef(df::item *item, df::specific_ref_type ty
 
 df::unit *Items::getOwner(df::item * item)
 {
+    CHECK_NULL_POINTER(item);
+
     auto ref = getGeneralRef(item, general_ref_type::UNIT_ITEMOWNER);
 
     return ref ? ref->getUnit() : NULL;
@@ -585,6 +593,8 @@ bool Items::setOwner(df::item *item, df::unit *unit)
 
 df::item *Items::getContainer(df::item * item)
 {
+    CHECK_NULL_POINTER(item);
+
     auto ref = getGeneralRef(item, general_ref_type::CONTAINED_IN_ITEM);
 
     return ref ? ref->getItem() : NULL;
@@ -610,6 +620,8 @@ void Items::getContainedItems(df::item *item, std::vector<df::item*> *items)
 
 df::building *Items::getHolderBuilding(df::item * item)
 {
+    CHECK_NULL_POINTER(item);
+
     auto ref = getGeneralRef(item, general_ref_type::BUILDING_HOLDER);
 
     return ref ? ref->getBuilding() : NULL;
@@ -617,15 +629,34 @@ df::building *Items::getHolderBuilding(df::item * item)
 
 df::unit *Items::getHolderUnit(df::item * item)
 {
+    CHECK_NULL_POINTER(item);
+
     auto ref = getGeneralRef(item, general_ref_type::UNIT_HOLDER);
 
     return ref ? ref->getUnit() : NULL;
 }
 
-df::coord Items::getPosition(df::item *item)
+typedef std::unordered_map<df::item*, df::coord> container_positions;
+
+static df::coord item_position(df::item *item, container_positions *memo);
+
+static df::coord container_position(df::item *container, container_positions *memo)
 {
-    CHECK_NULL_POINTER(item);
+    if (!memo)
+        return item_position(container, NULL);
+
+    // Items in the same container share the walk up from it.
+    auto it = memo->find(container);
+    if (it != memo->end())
+        return it->second;
 
+    df::coord pos = item_position(container, memo);
+    (*memo)[container] = pos;
+    return pos;
+}
+
+static df::coord item_position(df::item *item, container_positions *memo)
+{
     /* Function reverse-engineered from DF code. */
 
     if (item->flags.bits.removed)
@@ -641,7 +672,7 @@ df::coord Items::getPosition(df::item *item)
             {
             case general_ref_type::CONTAINED_IN_ITEM:
                 if (auto item2 = ref->getItem())
-                    return getPosition(item2);
+                    return container_position(item2, memo);
                 break;
 
             case general_ref_type::UNIT_HOLDER:
@@ -679,6 +710,50 @@ df::coord Items::getPosition(df::item *item)
     return item->pos;
 }
 
+df::coord Items::getPosition(df::item *item)
+{
+    CHECK_NULL_POINTER(item);
+
+    return item_position(item, NULL);
+}
+
+void Items::getPositions(const std::vector<df::item*> &items, std::vector<df::coord> *positions)
+{
+    positions->resize(items.size());
+
+    container_positions memo;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        CHECK_NULL_POINTER(items[i]);
+        (*positions)[i] = item_position(items[i], &memo);
+    }
+}
+
+void Items::getOwners(const std::vector<df::item*> &items, std::vector<df::unit*> *owners)
+{
+    owners->resize(items.size());
+
+    // Owners tend to own many of the items asked about together.
+    std::unordered_map<int32_t, df::unit*> units;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        CHECK_NULL_POINTER(items[i]);
+
+        auto ref = getGeneralRef(items[i], general_ref_type::UNIT_ITEMOWNER);
+        auto owner_ref = virtual_cast<df::general_ref_unit>(ref);
+        if (!owner_ref)
+        {
+            (*owners)[i] = ref ? ref->getUnit() : NULL;
+            continue;
+        }
+
+        auto it = units.find(owner_ref->unit_id);
+        if (it == units.end())
+            it = units.emplace(owner_ref->unit_id, ref->getUnit()).first;
+        (*owners)[i] = it->second;
+    }
+}
+
 static char quality_table[] = { 0, '-', '+', '*', '=', '@' };
 
 static void addQuality(std::string &tmp, int quality)
@@ -1595,3 +1670,181 @@ bool Items::isSquadEquipment(df::item *item)
     auto &vec = ui->equipment.items_assigned[item->getType()];
     return binsearch_index(vec, &df::item::id, item->id) >= 0;
 }
+
+// Clothing ledger. Type, subtype, material and maker race never change for an
+// item, so they are worked out once per item; ownership, wear and flags are
+// re-read when the counts are refreshed. Only the unowned counts are kept for
+// the frame; owned counts are built from the one unit's owned_items on demand.
+namespace {
+    struct ClothingClass
+    {
+        df::item_type type;
+        int16_t subtype;
+        uint32_t material_mask;
+        int32_t maker_race;
+        int32_t seen_frame;
+    };
+
+    typedef std::tuple<df::item_type, int16_t, uint32_t, int32_t> ClothingKey;
+
+    struct ClothingLedger
+    {
+        int32_t frame = -1;
+        std::unordered_map<int32_t, ClothingClass> classes;
+        std::vector<ClothingCount> unowned;
+    };
+
+    std::mutex clothing_ledger_mutex;
+    ClothingLedger clothing_ledger;
+}
+
+static uint32_t getClothingMaterialMask(df::item *item)
+{
+    MaterialInfo mat(item);
+    uint32_t mask = 0;
+    df::job_material_category cat;
+    for (int bit = 0; bit < 32; bit++)
+    {
+        cat.whole = 1u << bit;
+        if (mat.matches(cat))
+            mask |= cat.whole;
+    }
+    return mask;
+}
+
+static bool isClothingType(df::item_type type)
+{
+    switch (type)
+    {
+    case item_type::ARMOR:
+    case item_type::SHOES:
+    case item_type::HELM:
+    case item_type::GLOVES:
+    case item_type::PANTS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Item ids and frame counters start over in another save.
+void items_onStateChange(color_ostream &out, state_change_event event)
+{
+    switch (event) {
+    case SC_WORLD_LOADED:
+    case SC_WORLD_UNLOADED:
+    case SC_MAP_LOADED:
+    case SC_MAP_UNLOADED:
+    {
+        std::lock_guard<std::mutex> lock(clothing_ledger_mutex);
+        clothing_ledger.frame = -1;
+        clothing_ledger.classes.clear();
+        clothing_ledger.unowned.clear();
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static ClothingClass &classifyClothing(df::item *item)
+{
+    auto it = clothing_ledger.classes.find(item->id);
+    if (it == clothing_ledger.classes.end())
+    {
+        ClothingClass cls = {
+            item->getType(), item->getSubtype(),
+            getClothingMaterialMask(item), item->getMakerRace(), clothing_ledger.frame
+        };
+        it = clothing_ledger.classes.insert(std::make_pair(item->id, cls)).first;
+    }
+    return it->second;
+}
+
+static void addClothingCount(std::vector<ClothingCount> &counts, std::map<ClothingKey, size_t> &index,
+                             const ClothingClass &cls, bool available)
+{
+    ClothingKey key(cls.type, cls.subtype, cls.material_mask, cls.maker_race);
+    auto it = index.find(key);
+    if (it == index.end())
+    {
+        ClothingCount count = { cls.type, cls.subtype, cls.material_mask, cls.maker_race, 0, 0 };
+        it = index.insert(std::make_pair(key, counts.size())).first;
+        counts.push_back(count);
+    }
+    counts[it->second].count++;
+    if (available)
+        counts[it->second].available++;
+}
+
+static void refreshUnownedClothing()
+{
+    auto &ledger = clothing_ledger;
+    if (ledger.frame == world->frame_counter)
+        return;
+    ledger.frame = world->frame_counter;
+    ledger.unowned.clear();
+
+    df::item_flags bad_flags;
+    bad_flags.whole = 0;
+#define F(x) bad_flags.bits.x = true;
+    F(dump); F(forbid); F(garbage_collect);
+    F(hostile); F(on_fire); F(rotten); F(trader);
+    F(in_building); F(construction);
+#undef F
+
+    static const df::items_other_id clothing_vectors[] = {
+        items_other_id::ARMOR, items_other_id::SHOES, items_other_id::HELM,
+        items_other_id::GLOVES, items_other_id::PANTS
+    };
+
+    std::map<ClothingKey, size_t> unowned_index;
+    for (auto vec_id : clothing_vectors)
+    {
+        for (auto item : world->items.other[vec_id])
+        {
+            auto &cls = classifyClothing(item);
+            cls.seen_frame = ledger.frame;
+            if (item->flags.bits.owned)
+                continue;
+            bool available = !(item->flags.whole & bad_flags.whole) && item->getWear() < 1;
+            addClothingCount(ledger.unowned, unowned_index, cls, available);
+        }
+    }
+
+    // Drop the classes of items that no longer exist.
+    for (auto it = ledger.classes.begin(); it != ledger.classes.end();)
+    {
+        if (it->second.seen_frame == ledger.frame)
+            ++it;
+        else
+            it = ledger.classes.erase(it);
+    }
+}
+
+void Items::getUnownedClothing(std::vector<ClothingCount> *counts)
+{
+    CHECK_NULL_POINTER(counts);
+    std::lock_guard<std::mutex> lock(clothing_ledger_mutex);
+    refreshUnownedClothing();
+    *counts = clothing_ledger.unowned;
+}
+
+void Items::getOwnedClothing(df::unit *unit, std::vector<ClothingCount> *counts)
+{
+    CHECK_NULL_POINTER(unit);
+    CHECK_NULL_POINTER(counts);
+    counts->clear();
+    if (unit->owned_items.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(clothing_ledger_mutex);
+    std::map<ClothingKey, size_t> owned_index;
+    for (auto id : unit->owned_items)
+    {
+        auto item = df::item::find(id);
+        if (!item || !isClothingType(item->getType()))
+            continue;
+        addClothingCount(*counts, owned_index, classifyClothing(item), false);
+    }
+}
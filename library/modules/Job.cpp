@@ -28,6 +28,8 @@ distribution.
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <unordered_map>
 #include <cassert>
 using namespace std;
 
@@ -49,6 +51,7 @@ using namespace std;
 #include "df/job.h"
 #include "df/job_item.h"
 #include "df/job_list_link.h"
+#include "df/manager_order.h"
 #include "df/specific_ref.h"
 #include "df/general_ref.h"
 #include "df/general_ref_unit_workerst.h"
@@ -643,3 +646,265 @@ std::string Job::getName(df::job *job)
 
     return desc;
 }
+
+// The signature fields of a manager order that are compared for a given
+// field mask. Fields outside the mask are left at fixed values.
+struct order_signature
+{
+    int16_t job_type = -1;
+    int16_t item_type = -1;
+    int16_t item_subtype = -1;
+    int16_t mat_type = -1;
+    int32_t mat_index = -1;
+    uint32_t item_category = 0;
+    uint32_t material_category = 0;
+    int32_t hist_figure_id = -1;
+    std::string reaction_name;
+
+    order_signature(const df::manager_order *order, int fields)
+    {
+        if (fields & Job::ORDER_JOB_TYPE)
+            job_type = order->job_type;
+        if (fields & Job::ORDER_REACTION_NAME)
+            reaction_name = order->reaction_name;
+        if (fields & Job::ORDER_ITEM_TYPE)
+            item_type = order->item_type;
+        if (fields & Job::ORDER_ITEM_SUBTYPE)
+            item_subtype = order->item_subtype;
+        if (fields & Job::ORDER_MAT_TYPE)
+            mat_type = order->mat_type;
+        if (fields & Job::ORDER_MAT_INDEX)
+            mat_index = order->mat_index;
+        if (fields & Job::ORDER_ITEM_CATEGORY)
+            item_category = order->item_category.whole;
+        if (fields & Job::ORDER_MATERIAL_CATEGORY)
+            material_category = order->material_category.whole;
+        if (fields & Job::ORDER_HIST_FIGURE)
+            hist_figure_id = order->hist_figure_id;
+    }
+
+    bool operator==(const order_signature &other) const
+    {
+        return job_type == other.job_type && item_type == other.item_type &&
+            item_subtype == other.item_subtype && mat_type == other.mat_type &&
+            mat_index == other.mat_index && item_category == other.item_category &&
+            material_category == other.material_category &&
+            hist_figure_id == other.hist_figure_id && reaction_name == other.reaction_name;
+    }
+};
+
+struct order_signature_hash
+{
+    size_t operator()(const order_signature &sig) const
+    {
+        size_t h = std::hash<std::string>()(sig.reaction_name);
+        uint64_t parts[] = {
+            (uint64_t(uint16_t(sig.job_type)) << 48) | (uint64_t(uint16_t(sig.item_type)) << 32) |
+            (uint64_t(uint16_t(sig.item_subtype)) << 16) | uint64_t(uint16_t(sig.mat_type)),
+            (uint64_t(uint32_t(sig.mat_index)) << 32) | uint32_t(sig.hist_figure_id),
+            (uint64_t(sig.item_category) << 32) | sig.material_category
+        };
+        for (uint64_t part : parts)
+            h = h * 31 + std::hash<uint64_t>()(part);
+        return h;
+    }
+};
+
+struct order_group
+{
+    std::vector<df::manager_order*> orders;
+    int amount_left = 0;
+};
+
+// Orders grouped by signature for one field mask. An index is checked
+// against the size, ends and next id of the order list before use, and the
+// orders of a group are checked against its signature when it is looked up.
+struct order_index
+{
+    bool valid = false;
+    size_t count = 0;
+    df::manager_order *first = NULL;
+    df::manager_order *last = NULL;
+    int32_t next_id = -1;
+    std::unordered_map<order_signature, order_group, order_signature_hash> groups;
+};
+
+static std::mutex order_index_mutex;
+static std::map<int, order_index> order_indexes;
+
+static void note_order_list(order_index &index)
+{
+    auto &orders = df::global::world->manager_orders;
+    index.count = orders.size();
+    index.first = orders.empty() ? NULL : orders.front();
+    index.last = orders.empty() ? NULL : orders.back();
+    index.next_id = df::global::world->manager_order_next_id;
+}
+
+static bool order_index_current(const order_index &index)
+{
+    auto &orders = df::global::world->manager_orders;
+    return index.valid && index.count == orders.size() &&
+        index.first == (orders.empty() ? NULL : orders.front()) &&
+        index.last == (orders.empty() ? NULL : orders.back()) &&
+        index.next_id == df::global::world->manager_order_next_id;
+}
+
+static order_index &get_order_index(int fields, bool force = false)
+{
+    auto &index = order_indexes[fields];
+    if (!force && order_index_current(index))
+        return index;
+
+    index.groups.clear();
+    for (auto order : df::global::world->manager_orders)
+        index.groups[order_signature(order, fields)].orders.push_back(order);
+    index.valid = true;
+    note_order_list(index);
+    return index;
+}
+
+// Sums up amount_left, which changes as jobs complete without the list changing.
+static bool refresh_order_group(order_group &group, const order_signature &sig, int fields)
+{
+    group.amount_left = 0;
+    for (auto order : group.orders)
+    {
+        if (!(order_signature(order, fields) == sig))
+            return false;
+        group.amount_left += order->amount_left;
+    }
+    return true;
+}
+
+static order_group *find_order_group(const df::manager_order *pattern, int fields)
+{
+    order_signature sig(pattern, fields);
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        auto &index = get_order_index(fields, attempt > 0);
+        auto it = index.groups.find(sig);
+        if (it == index.groups.end())
+            return NULL;
+        if (refresh_order_group(it->second, sig, fields))
+            return &it->second;
+    }
+    return NULL;
+}
+
+void Job::findOrders(std::vector<df::manager_order*> *orders, const df::manager_order *pattern, int fields)
+{
+    CHECK_NULL_POINTER(orders);
+    CHECK_NULL_POINTER(pattern);
+
+    std::lock_guard<std::mutex> lock(order_index_mutex);
+    auto group = find_order_group(pattern, fields);
+    if (group)
+        *orders = group->orders;
+    else
+        orders->clear();
+}
+
+int Job::getOrderAmountLeft(const df::manager_order *pattern, int fields)
+{
+    CHECK_NULL_POINTER(pattern);
+
+    std::lock_guard<std::mutex> lock(order_index_mutex);
+    auto group = find_order_group(pattern, fields);
+    return group ? group->amount_left : 0;
+}
+
+void Job::getOrderGroups(std::vector<std::pair<df::manager_order*, int> > *groups, int fields)
+{
+    CHECK_NULL_POINTER(groups);
+
+    std::lock_guard<std::mutex> lock(order_index_mutex);
+    auto &index = get_order_index(fields);
+    for (int attempt = 0; ; attempt++)
+    {
+        groups->clear();
+        bool stale = false;
+        for (auto &entry : index.groups)
+        {
+            if (!refresh_order_group(entry.second, entry.first, fields))
+            {
+                stale = true;
+                break;
+            }
+            groups->push_back(std::make_pair(entry.second.orders.front(), entry.second.amount_left));
+        }
+        if (!stale || attempt > 0)
+            break;
+        get_order_index(fields, true);
+    }
+}
+
+int Job::ensureOrderAmounts(const std::vector<df::manager_order*> &patterns,
+                            const std::vector<int> &amounts,
+                            int fields, bool add_new,
+                            std::vector<df::manager_order*> *created)
+{
+    CHECK_INVALID_ARGUMENT(patterns.size() == amounts.size());
+
+    auto world = df::global::world;
+    int num_created = 0;
+
+    std::lock_guard<std::mutex> lock(order_index_mutex);
+    for (size_t i = 0; i < patterns.size(); i++)
+    {
+        auto pattern = patterns[i];
+        CHECK_NULL_POINTER(pattern);
+
+        auto group = find_order_group(pattern, fields);
+        int missing = amounts[i] - (group ? group->amount_left : 0);
+        if (missing <= 0)
+            continue;
+
+        if (group && !add_new)
+        {
+            auto order = group->orders.back();
+            order->amount_left += missing;
+            order->amount_total += missing;
+            group->amount_left += missing;
+            continue;
+        }
+
+        std::vector<std::pair<int, order_index*> > current;
+        for (auto &entry : order_indexes)
+        {
+            if (order_index_current(entry.second))
+                current.push_back(std::make_pair(entry.first, &entry.second));
+        }
+
+        auto order = new df::manager_order();
+        order->job_type = pattern->job_type;
+        order->reaction_name = pattern->reaction_name;
+        order->item_type = pattern->item_type;
+        order->item_subtype = pattern->item_subtype;
+        order->mat_type = pattern->mat_type;
+        order->mat_index = pattern->mat_index;
+        order->item_category = pattern->item_category;
+        order->material_category = pattern->material_category;
+        order->hist_figure_id = pattern->hist_figure_id;
+        order->amount_left = missing;
+        order->amount_total = missing;
+        order->status.bits.validated = false;
+        order->status.bits.active = false;
+        order->id = world->manager_order_next_id++;
+        world->manager_orders.push_back(order);
+
+        // Keep the indexes that were current usable for the rest of the batch.
+        for (auto &entry : current)
+        {
+            auto &group = entry.second->groups[order_signature(order, entry.first)];
+            group.orders.push_back(order);
+            group.amount_left += order->amount_left;
+            note_order_list(*entry.second);
+        }
+
+        num_created++;
+        if (created)
+            created->push_back(order);
+    }
+    return num_created;
+}
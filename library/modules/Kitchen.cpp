@@ -7,6 +7,8 @@
 #include <cstdio>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 using namespace std;
 
 #include "VersionInfo.h"
@@ -46,67 +48,201 @@ void Kitchen::debug_print(color_ostream &out)
     out.print("\n");
 }
 
-void Kitchen::allowPlantSeedCookery(t_materialIndex materialIndex)
+struct exclusion_hash
 {
-    bool match = false;
-    do
+    size_t operator()(const Kitchen::Exclusion &e) const
     {
-        match = false;
-        std::size_t matchIndex = 0;
-        for(std::size_t i = 0; i < size(); ++i)
-        {
-            if(ui->kitchen.mat_indices[i] == materialIndex
-               && (ui->kitchen.item_types[i] == item_type::SEEDS || ui->kitchen.item_types[i] == item_type::PLANT)
-               && ui->kitchen.exc_types[i] == df::kitchen_exc_type::Cook
-            )
-            {
-                match = true;
-                matchIndex = i;
-            }
-        }
-        if(match)
-        {
-            ui->kitchen.item_types.erase(ui->kitchen.item_types.begin() + matchIndex);
-            ui->kitchen.item_subtypes.erase(ui->kitchen.item_subtypes.begin() + matchIndex);
-            ui->kitchen.mat_indices.erase(ui->kitchen.mat_indices.begin() + matchIndex);
-            ui->kitchen.mat_types.erase(ui->kitchen.mat_types.begin() + matchIndex);
-            ui->kitchen.exc_types.erase(ui->kitchen.exc_types.begin() + matchIndex);
-        }
-    } while(match);
+        uint64_t key = (uint64_t(uint8_t(e.type)) << 48) ^ (uint64_t(uint16_t(e.item_type)) << 32) ^
+                       (uint64_t(uint16_t(e.item_subtype)) << 16) ^ uint64_t(uint16_t(e.mat_type));
+        return std::hash<uint64_t>()(key ^ (uint64_t(uint32_t(e.mat_index)) * 0x9E3779B97F4A7C15ULL));
+    }
+};
+
+struct exclusion_equal
+{
+    bool operator()(const Kitchen::Exclusion &a, const Kitchen::Exclusion &b) const
+    {
+        return a.type == b.type && a.item_type == b.item_type && a.item_subtype == b.item_subtype &&
+               a.mat_type == b.mat_type && a.mat_index == b.mat_index;
+    }
+};
+
+static Kitchen::Exclusion exclusion_at(size_t i)
+{
+    Kitchen::Exclusion e;
+    e.type = ui->kitchen.exc_types[i];
+    e.item_type = ui->kitchen.item_types[i];
+    e.item_subtype = ui->kitchen.item_subtypes[i];
+    e.mat_type = ui->kitchen.mat_types[i];
+    e.mat_index = ui->kitchen.mat_indices[i];
+    return e;
 }
 
-void Kitchen::denyPlantSeedCookery(t_materialIndex materialIndex)
+// Hashed view of the exclusion list, mapping each entry to its first index.
+// DF edits the list from the kitchen screen, so the view is checked against
+// the size, storage and last entry of the vectors before each use and rebuilt
+// if they changed. Hits are also checked against the list itself.
+static struct
 {
-    df::plant_raw *type = world->raws.plants.all[materialIndex];
-    bool SeedAlreadyIn = false;
-    bool PlantAlreadyIn = false;
-    for(std::size_t i = 0; i < size(); ++i)
+    bool valid = false;
+    size_t count = 0;
+    const void *storage = NULL;
+    Kitchen::Exclusion last;
+    std::unordered_map<Kitchen::Exclusion, size_t, exclusion_hash, exclusion_equal> first_index;
+} exclusion_view;
+
+static void note_exclusion_list()
+{
+    exclusion_view.count = Kitchen::size();
+    exclusion_view.storage = ui->kitchen.mat_indices.data();
+    if (exclusion_view.count > 0)
+        exclusion_view.last = exclusion_at(exclusion_view.count - 1);
+}
+
+static bool exclusion_view_current()
+{
+    if (!exclusion_view.valid || exclusion_view.count != Kitchen::size() ||
+        exclusion_view.storage != ui->kitchen.mat_indices.data())
+        return false;
+    return exclusion_view.count == 0 ||
+        exclusion_equal()(exclusion_view.last, exclusion_at(exclusion_view.count - 1));
+}
+
+static void refresh_exclusion_view(bool force = false)
+{
+    if (!force && exclusion_view_current())
+        return;
+
+    exclusion_view.first_index.clear();
+    for (size_t i = 0; i < Kitchen::size(); i++)
+        exclusion_view.first_index.emplace(exclusion_at(i), i);
+    exclusion_view.valid = true;
+    note_exclusion_list();
+}
+
+static int find_exclusion(const Kitchen::Exclusion &e)
+{
+    for (int attempt = 0; attempt < 2; attempt++)
     {
-        if(ui->kitchen.mat_indices[i] == materialIndex
-           && ui->kitchen.exc_types[i] == df::kitchen_exc_type::Cook)
-        {
-            if(ui->kitchen.item_types[i] == item_type::SEEDS)
-                SeedAlreadyIn = true;
-            else if (ui->kitchen.item_types[i] == item_type::PLANT)
-                PlantAlreadyIn = true;
-        }
+        refresh_exclusion_view(attempt > 0);
+        auto it = exclusion_view.first_index.find(e);
+        if (it == exclusion_view.first_index.end())
+            return -1;
+        if (it->second < Kitchen::size() && exclusion_equal()(exclusion_at(it->second), e))
+            return int(it->second);
     }
-    if(!SeedAlreadyIn)
+    return -1;
+}
+
+static void push_exclusion(const Kitchen::Exclusion &e)
+{
+    bool current = exclusion_view_current();
+
+    ui->kitchen.item_types.push_back(e.item_type);
+    ui->kitchen.item_subtypes.push_back(e.item_subtype);
+    ui->kitchen.mat_types.push_back(e.mat_type);
+    ui->kitchen.mat_indices.push_back(e.mat_index);
+    ui->kitchen.exc_types.push_back(e.type);
+
+    if (current)
     {
-        ui->kitchen.item_types.push_back(item_type::SEEDS);
-        ui->kitchen.item_subtypes.push_back(organicSubtype);
-        ui->kitchen.mat_types.push_back(type->material_defs.type[plant_material_def::seed]);
-        ui->kitchen.mat_indices.push_back(materialIndex);
-        ui->kitchen.exc_types.push_back(df::kitchen_exc_type::Cook);
+        exclusion_view.first_index.emplace(e, Kitchen::size() - 1);
+        note_exclusion_list();
     }
-    if(!PlantAlreadyIn)
+    else
+        exclusion_view.valid = false;
+}
+
+// Removes the entries matching pred, compacting all the vectors in one pass.
+template<typename Pred>
+static size_t erase_exclusions_if(Pred pred)
+{
+    auto &k = ui->kitchen;
+    size_t count = Kitchen::size(), out = 0;
+    for (size_t i = 0; i < count; i++)
     {
-        ui->kitchen.item_types.push_back(item_type::PLANT);
-        ui->kitchen.item_subtypes.push_back(organicSubtype);
-        ui->kitchen.mat_types.push_back(type->material_defs.type[plant_material_def::basic_mat]);
-        ui->kitchen.mat_indices.push_back(materialIndex);
-        ui->kitchen.exc_types.push_back(df::kitchen_exc_type::Cook);
+        if (pred(i))
+            continue;
+        if (out != i)
+        {
+            k.item_types[out] = k.item_types[i];
+            k.item_subtypes[out] = k.item_subtypes[i];
+            k.mat_types[out] = k.mat_types[i];
+            k.mat_indices[out] = k.mat_indices[i];
+            k.exc_types[out] = k.exc_types[i];
+        }
+        out++;
     }
+
+    if (out == count)
+        return 0;
+
+    k.item_types.resize(out);
+    k.item_subtypes.resize(out);
+    k.mat_types.resize(out);
+    k.mat_indices.resize(out);
+    k.exc_types.resize(out);
+    exclusion_view.valid = false;
+    return count - out;
+}
+
+static bool is_plant_seed_cookery(size_t i)
+{
+    return (ui->kitchen.item_types[i] == item_type::SEEDS || ui->kitchen.item_types[i] == item_type::PLANT)
+        && ui->kitchen.exc_types[i] == df::kitchen_exc_type::Cook;
+}
+
+static bool is_limit(size_t i)
+{
+    return ui->kitchen.item_types[i] == Kitchen::limitType
+        && ui->kitchen.item_subtypes[i] == Kitchen::limitSubtype
+        && ui->kitchen.exc_types[i] == Kitchen::limitExclusion;
+}
+
+void Kitchen::allowPlantSeedCookery(t_materialIndex materialIndex)
+{
+    erase_exclusions_if([&](size_t i) {
+        return ui->kitchen.mat_indices[i] == materialIndex && is_plant_seed_cookery(i);
+    });
+}
+
+void Kitchen::allowPlantSeedCookery(const std::vector<t_materialIndex> &materialIndices)
+{
+    if (materialIndices.empty())
+        return;
+
+    std::unordered_set<t_materialIndex> materials(materialIndices.begin(), materialIndices.end());
+    erase_exclusions_if([&](size_t i) {
+        return materials.count(ui->kitchen.mat_indices[i]) && is_plant_seed_cookery(i);
+    });
+}
+
+void Kitchen::denyPlantSeedCookery(t_materialIndex materialIndex)
+{
+    denyPlantSeedCookery(std::vector<t_materialIndex>(1, materialIndex));
+}
+
+void Kitchen::denyPlantSeedCookery(const std::vector<t_materialIndex> &materialIndices)
+{
+    std::vector<Exclusion> exclusions;
+    exclusions.reserve(materialIndices.size() * 2);
+    for (auto materialIndex : materialIndices)
+    {
+        df::plant_raw *type = world->raws.plants.all[materialIndex];
+        Exclusion e;
+        e.type = df::kitchen_exc_type::Cook;
+        e.item_subtype = organicSubtype;
+        e.mat_index = materialIndex;
+
+        e.item_type = item_type::SEEDS;
+        e.mat_type = type->material_defs.type[plant_material_def::seed];
+        exclusions.push_back(e);
+
+        e.item_type = item_type::PLANT;
+        e.mat_type = type->material_defs.type[plant_material_def::basic_mat];
+        exclusions.push_back(e);
+    }
+    addExclusions(exclusions);
 }
 
 void Kitchen::fillWatchMap(std::map<t_materialIndex, unsigned int>& watchMap)
@@ -123,31 +259,9 @@ void Kitchen::fillWatchMap(std::map<t_materialIndex, unsigned int>& watchMap)
 
 void Kitchen::removeLimit(t_materialIndex materialIndex)
 {
-    bool match = false;
-    do
-    {
-        match = false;
-        std::size_t matchIndex = 0;
-        for(std::size_t i = 0; i < size(); ++i)
-        {
-            if(ui->kitchen.item_types[i] == limitType
-               && ui->kitchen.item_subtypes[i] == limitSubtype
-               && ui->kitchen.mat_indices[i] == materialIndex
-               && ui->kitchen.exc_types[i] == limitExclusion)
-            {
-                match = true;
-                matchIndex = i;
-            }
-        }
-        if(match)
-        {
-            ui->kitchen.item_types.erase(ui->kitchen.item_types.begin() + matchIndex);
-            ui->kitchen.item_subtypes.erase(ui->kitchen.item_subtypes.begin() + matchIndex);
-            ui->kitchen.mat_types.erase(ui->kitchen.mat_types.begin() + matchIndex);
-            ui->kitchen.mat_indices.erase(ui->kitchen.mat_indices.begin() + matchIndex);
-            ui->kitchen.exc_types.erase(ui->kitchen.exc_types.begin() + matchIndex);
-        }
-    } while(match);
+    erase_exclusions_if([&](size_t i) {
+        return ui->kitchen.mat_indices[i] == materialIndex && is_limit(i);
+    });
 }
 
 void Kitchen::setLimit(t_materialIndex materialIndex, unsigned int limit)
@@ -157,39 +271,18 @@ void Kitchen::setLimit(t_materialIndex materialIndex, unsigned int limit)
     {
         limit = seedLimit;
     }
-    ui->kitchen.item_types.push_back(limitType);
-    ui->kitchen.item_subtypes.push_back(limitSubtype);
-    ui->kitchen.mat_indices.push_back(materialIndex);
-    ui->kitchen.mat_types.push_back((t_materialType) (limit < seedLimit) ? limit : seedLimit);
-    ui->kitchen.exc_types.push_back(limitExclusion);
+    Exclusion e;
+    e.type = limitExclusion;
+    e.item_type = limitType;
+    e.item_subtype = limitSubtype;
+    e.mat_type = (t_materialType) (limit < seedLimit) ? limit : seedLimit;
+    e.mat_index = materialIndex;
+    push_exclusion(e);
 }
 
 void Kitchen::clearLimits()
 {
-    bool match = false;
-    do
-    {
-        match = false;
-        std::size_t matchIndex;
-        for(std::size_t i = 0; i < size(); ++i)
-        {
-            if(ui->kitchen.item_types[i] == limitType
-               && ui->kitchen.item_subtypes[i] == limitSubtype
-               && ui->kitchen.exc_types[i] == limitExclusion)
-            {
-                match = true;
-                matchIndex = i;
-            }
-        }
-        if(match)
-        {
-            ui->kitchen.item_types.erase(ui->kitchen.item_types.begin() + matchIndex);
-            ui->kitchen.item_subtypes.erase(ui->kitchen.item_subtypes.begin() + matchIndex);
-            ui->kitchen.mat_indices.erase(ui->kitchen.mat_indices.begin() + matchIndex);
-            ui->kitchen.mat_types.erase(ui->kitchen.mat_types.begin() + matchIndex);
-            ui->kitchen.exc_types.erase(ui->kitchen.exc_types.begin() + matchIndex);
-        }
-    } while(match);
+    erase_exclusions_if(is_limit);
 }
 
 size_t Kitchen::size()
@@ -197,36 +290,35 @@ size_t Kitchen::size()
     return ui->kitchen.item_types.size();
 }
 
+static Kitchen::Exclusion make_exclusion(df::kitchen_exc_type type,
+    df::item_type item_type, int16_t item_subtype,
+    int16_t mat_type, int32_t mat_index)
+{
+    Kitchen::Exclusion e;
+    e.type = type;
+    e.item_type = item_type;
+    e.item_subtype = item_subtype;
+    e.mat_type = mat_type;
+    e.mat_index = mat_index;
+    return e;
+}
+
 int Kitchen::findExclusion(df::kitchen_exc_type type,
     df::item_type item_type, int16_t item_subtype,
     int16_t mat_type, int32_t mat_index)
 {
-    for (size_t i = 0; i < size(); i++)
-    {
-        if (ui->kitchen.item_types[i] == item_type &&
-            ui->kitchen.item_subtypes[i] == item_subtype &&
-            ui->kitchen.mat_types[i] == mat_type &&
-            ui->kitchen.mat_indices[i] == mat_index &&
-            ui->kitchen.exc_types[i] == type)
-        {
-            return int(i);
-        }
-    }
-    return -1;
+    return find_exclusion(make_exclusion(type, item_type, item_subtype, mat_type, mat_index));
 }
 
 bool Kitchen::addExclusion(df::kitchen_exc_type type,
     df::item_type item_type, int16_t item_subtype,
     int16_t mat_type, int32_t mat_index)
 {
-    if (findExclusion(type, item_type, item_subtype, mat_type, mat_index) >= 0)
+    auto e = make_exclusion(type, item_type, item_subtype, mat_type, mat_index);
+    if (find_exclusion(e) >= 0)
         return false;
 
-    ui->kitchen.item_types.push_back(item_type);
-    ui->kitchen.item_subtypes.push_back(item_subtype);
-    ui->kitchen.mat_types.push_back(mat_type);
-    ui->kitchen.mat_indices.push_back(mat_index);
-    ui->kitchen.exc_types.push_back(type);
+    push_exclusion(e);
     return true;
 }
 
@@ -234,7 +326,7 @@ bool Kitchen::removeExclusion(df::kitchen_exc_type type,
     df::item_type item_type, int16_t item_subtype,
     int16_t mat_type, int32_t mat_index)
 {
-    int i = findExclusion(type, item_type, item_subtype, mat_type, mat_index);
+    int i = find_exclusion(make_exclusion(type, item_type, item_subtype, mat_type, mat_index));
     if (i < 0)
         return false;
 
@@ -243,5 +335,31 @@ bool Kitchen::removeExclusion(df::kitchen_exc_type type,
     ui->kitchen.mat_types.erase(ui->kitchen.mat_types.begin() + i);
     ui->kitchen.mat_indices.erase(ui->kitchen.mat_indices.begin() + i);
     ui->kitchen.exc_types.erase(ui->kitchen.exc_types.begin() + i);
+    exclusion_view.valid = false;
     return true;
 }
+
+size_t Kitchen::addExclusions(const std::vector<Exclusion> &exclusions)
+{
+    size_t added = 0;
+    for (auto &e : exclusions)
+    {
+        if (find_exclusion(e) >= 0)
+            continue;
+
+        push_exclusion(e);
+        added++;
+    }
+    return added;
+}
+
+size_t Kitchen::removeExclusions(const std::vector<Exclusion> &exclusions)
+{
+    if (exclusions.empty())
+        return 0;
+
+    std::unordered_set<Exclusion, exclusion_hash, exclusion_equal> remove(exclusions.begin(), exclusions.end());
+    return erase_exclusions_if([&](size_t i) {
+        return remove.count(exclusion_at(i)) > 0;
+    });
+}
@@ -30,6 +30,8 @@ distribution.
 #include <map>
 #include <set>
 #include <cstdlib>
+#include <algorithm>
+#include <mutex>
 #include <iostream>
 using namespace std;
 
@@ -769,58 +771,68 @@ bool MapExtras::Block::Write ()
     return true;
 }
 
-void MapExtras::BlockInfo::prepare(Block *mblock)
+/*
+ * Fills a block's plant tiles. Only the plants of the block's column are
+ * considered, and of each tree only the part of its slice at the block's z
+ * level that overlaps the block is read. Nothing is cached, since shrubs can
+ * be replaced and tree tiles change in place as trees grow or are cut.
+ */
+static void rasterize_block_plants(df::plant *(&plants)[16][16], df::map_block_column *column,
+                                   df::coord map_pos)
 {
-    this->mblock = mblock;
-
-    block = mblock->getRaw();
-    parent = mblock->getParent();
-    column = Maps::getBlockColumn((block->map_pos.x / 48) * 3, (block->map_pos.y / 48) * 3);
-
-    SquashVeins(block, veinmats, veintype);
-    SquashGrass(block, grass);
-
     for (size_t i = 0; i < column->plants.size(); i++)
     {
         auto pp = column->plants[i];
         // A plant without tree_info is single tile
-        // TODO: verify that x any y lie inside the block.
         if (!pp->tree_info)
         {
-            if (pp->pos.z == block->map_pos.z)
-                plants[pp->pos] = pp;
+            int x = pp->pos.x - map_pos.x, y = pp->pos.y - map_pos.y;
+            if (pp->pos.z == map_pos.z && x >= 0 && x < 16 && y >= 0 && y < 16)
+                plants[x][y] = pp;
             continue;
         }
 
         // tree_info contains vertical slices of the tree. This ensures there's a slice for our Z-level.
         df::plant_tree_info * info = pp->tree_info;
-        if (!((pp->pos.z - info->roots_depth <= block->map_pos.z) && ((pp->pos.z + info->body_height) > block->map_pos.z)))
+        int z_diff = map_pos.z - pp->pos.z;
+        if (z_diff < -info->roots_depth || z_diff >= info->body_height)
             continue;
 
-        // Parse through a single horizontal slice of the tree.
-        for (int xx = 0; xx < info->dim_x; xx++)
-        for (int yy = 0; yy < info->dim_y; yy++)
+        // Clip the slice to the block.
+        int x0 = pp->pos.x - (info->dim_x / 2) - map_pos.x;
+        int y0 = pp->pos.y - (info->dim_y / 2) - map_pos.y;
+        int xx1 = std::max(0, -x0), xx2 = std::min<int>(info->dim_x, 16 - x0);
+        int yy1 = std::max(0, -y0), yy2 = std::min<int>(info->dim_y, 16 - y0);
+
+        // Parse through the overlapping part of a single horizontal slice of the tree.
+        // Any non-zero value here other than blocked means there's some sort of branch here.
+        // If the block is at or above the plant's base level, we use the body array
+        // otherwise we use the roots.
+        df::plant_tree_tile *slice = z_diff >= 0 ? info->body[z_diff] : info->roots[-1 - z_diff];
+        for (int xx = xx1; xx < xx2; xx++)
+        for (int yy = yy1; yy < yy2; yy++)
         {
-            // Any non-zero value here other than blocked means there's some sort of branch here.
-            // If the block is at or above the plant's base level, we use the body array
-            // otherwise we use the roots.
-            // TODO: verify that the tree bounds intersect the block.
-            df::plant_tree_tile tile;
-            int z_diff = block->map_pos.z - pp->pos.z;
-            if (z_diff >= 0)
-                tile = info->body[z_diff][xx + (yy*info->dim_x)];
-            else
-                tile = info->roots[-1 - z_diff][xx + (yy*info->dim_x)];
+            df::plant_tree_tile tile = slice[xx + (yy*info->dim_x)];
             if (tile.whole && !(tile.bits.blocked))
-            {
-                df::coord pos = pp->pos;
-                pos.x = pos.x - (info->dim_x / 2) + xx;
-                pos.y = pos.y - (info->dim_y / 2) + yy;
-                pos.z = block->map_pos.z;
-                plants[pos] = pp;
-            }
+                plants[x0 + xx][y0 + yy] = pp;
         }
     }
+}
+
+void MapExtras::BlockInfo::prepare(Block *mblock)
+{
+    this->mblock = mblock;
+
+    block = mblock->getRaw();
+    parent = mblock->getParent();
+    column = Maps::getBlockColumn((block->map_pos.x / 48) * 3, (block->map_pos.y / 48) * 3);
+
+    SquashVeins(block, veinmats, veintype);
+    SquashGrass(block, grass);
+
+    memset(plants, 0, sizeof(plants));
+    if (column)
+        rasterize_block_plants(plants, column, block->map_pos);
 
     global_feature = Maps::getGlobalInitFeature(block->global_feature);
     local_feature = Maps::getLocalInitFeature(block->region_pos, block->local_feature);
@@ -895,7 +907,7 @@ t_matpair MapExtras::BlockInfo::getBaseMaterial(df::tiletype tt, df::coord2d pos
     case TREE:
     case PLANT:
         rv.mat_type = MaterialInfo::PLANT_BASE;
-        if (auto plant = plants[block->map_pos + df::coord(x,y,0)])
+        if (auto plant = plants[x][y])
         {
             if (auto raw = df::plant_raw::find(plant->material))
             {
@@ -1071,7 +1083,7 @@ int MapExtras::Block::biomeIndexAt(df::coord2d p)
     if (idx >= 9)
         return -1;
     idx = block->region_offset[idx];
-    if (idx >= parent->biomes.size())
+    if (idx >= parent->geology->biomes.size())
         return -1;
     return idx;
 }
@@ -1090,7 +1102,7 @@ df::coord2d MapExtras::Block::biomeRegionAt(df::coord2d p)
     if (idx < 0)
         return block->region_pos;
 
-    return parent->biomes[idx].pos;
+    return parent->geology->biomes[idx].pos;
 }
 
 bool MapExtras::Block::GetGlobalFeature(t_feature *out)
@@ -1194,32 +1206,36 @@ bool MapExtras::Block::removeItemOnGround(df::item *item)
     return true;
 }
 
-MapExtras::MapCache::MapCache()
+static std::mutex geology_mutex;
+static size_t geology_details = 0;
+static std::shared_ptr<const GeologyInfo> geology_cache;
+
+static std::shared_ptr<const GeologyInfo> build_geology()
 {
-    valid = 0;
-    Maps::getSize(x_bmax, y_bmax, z_max);
-    x_tmax = x_bmax*16; y_tmax = y_bmax*16;
+    auto geo = std::make_shared<GeologyInfo>();
     std::vector<df::coord2d> geoidx;
     std::vector<std::vector<int16_t> > layer_mats;
-    validgeo = Maps::ReadGeology(&layer_mats, &geoidx);
-    valid = true;
-
-    if (auto data = df::global::world->world_data)
-    {
-        for (size_t i = 0; i < data->region_details.size(); i++)
-        {
-            auto info = data->region_details[i];
-            region_details[info->pos] = info;
-        }
-    }
+    geo->valid = Maps::ReadGeology(&layer_mats, &geoidx);
 
+    auto &biomes = geo->biomes;
     biomes.resize(layer_mats.size());
 
     for (size_t i = 0; i < layer_mats.size(); i++)
     {
         biomes[i].pos = geoidx[i];
         biomes[i].biome = Maps::getRegionBiome(geoidx[i]);
-        biomes[i].details = region_details[geoidx[i]];
+        biomes[i].details = NULL;
+        if (auto data = world->world_data)
+        {
+            for (size_t j = 0; j < data->region_details.size(); j++)
+            {
+                if (data->region_details[j]->pos == geoidx[i])
+                {
+                    biomes[i].details = data->region_details[j];
+                    break;
+                }
+            }
+        }
 
         biomes[i].geo_index = biomes[i].biome ? biomes[i].biome->geo_index : -1;
         biomes[i].geobiome = df::world_geo_biome::find(biomes[i].geo_index);
@@ -1247,12 +1263,54 @@ MapExtras::MapCache::MapCache()
             else if (biomes[i].default_stone == -1)
                 biomes[i].default_stone = layer_mats[i][j];
         }
+    }
+
+    return geo;
+}
+
+std::shared_ptr<const GeologyInfo> MapExtras::GeologyInfo::get()
+{
+    std::lock_guard<std::mutex> lock(geology_mutex);
+    // Region details may be added while the map is loaded, and a new one can
+    // hold the lava stone of a biome.
+    size_t details = world->world_data ? world->world_data->region_details.size() : 0;
+    if (!geology_cache || geology_details != details)
+    {
+        geology_cache = build_geology();
+        geology_details = details;
+    }
+    return geology_cache;
+}
+
+void MapExtras::GeologyInfo::invalidate()
+{
+    std::lock_guard<std::mutex> lock(geology_mutex);
+    geology_cache.reset();
+}
 
-        while (layer_mats[i].size() < 16)
-            layer_mats[i].push_back(-1);
+void mapcache_onStateChange(color_ostream &out, state_change_event event)
+{
+    switch (event) {
+    case SC_WORLD_LOADED:
+    case SC_WORLD_UNLOADED:
+    case SC_MAP_LOADED:
+    case SC_MAP_UNLOADED:
+        GeologyInfo::invalidate();
+        break;
+    default:
+        break;
     }
 }
 
+MapExtras::MapCache::MapCache()
+{
+    valid = 0;
+    Maps::getSize(x_bmax, y_bmax, z_max);
+    x_tmax = x_bmax*16; y_tmax = y_bmax*16;
+    geology = GeologyInfo::get();
+    valid = true;
+}
+
 bool MapExtras::MapCache::WriteAll()
 {
     auto world = df::global::world;
@@ -503,6 +503,20 @@ bool Units::isCitizen(df::unit *unit)
     return isOwnGroup(unit);
 }
 
+bool Units::getCitizens(std::vector<df::unit*> &citizens)
+{
+    citizens.clear();
+    if (!world || !ui)
+        return false;
+
+    for (auto unit : world->units.active)
+    {
+        if (isCitizen(unit))
+            citizens.push_back(unit);
+    }
+    return true;
+}
+
 bool Units::isDwarf(df::unit *unit)
 {
     CHECK_NULL_POINTER(unit);
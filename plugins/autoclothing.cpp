@@ -11,6 +11,7 @@
 #include "DataDefs.h"
 
 #include "modules/Items.h"
+#include "modules/Job.h"
 #include "modules/Maps.h"
 #include "modules/Materials.h"
 #include "modules/Units.h"
@@ -464,36 +465,35 @@ command_result autoclothing(color_ostream &out, std::vector <std::string> & para
     return CR_OK;
 }
 
+static bool clothing_matches(const ClothingCount &count, const ClothingRequirement &clothingOrder)
+{
+    if (count.type != clothingOrder.itemType)
+        return false;
+    if (count.subtype != clothingOrder.item_subtype)
+        return false;
+    return (count.material_mask & clothingOrder.material_category.whole) != 0;
+}
+
 static void find_needed_clothing_items()
 {
+    std::vector<ClothingCount> owned;
     for (auto& unit : world->units.active)
     {
         //obviously we don't care about illegal aliens.
         if (!isCitizen(unit))
             continue;
 
+        getOwnedClothing(unit, &owned);
+
         //now check each clothing order to see what the unit might be missing.
         for (auto& clothingOrder : clothingOrders)
         {
             int alreadyOwnedAmount = 0;
 
-            //looping through the items first, then clothing order might be a little faster, but this way is cleaner.
-            for (auto& ownedItem : unit->owned_items)
+            for (auto& ownedCount : owned)
             {
-                auto item = findItemByID(ownedItem);
-
-                if (item->getType() != clothingOrder.itemType)
-                    continue;
-                if (item->getSubtype() != clothingOrder.item_subtype)
-                    continue;
-
-                MaterialInfo matInfo;
-                matInfo.decode(item);
-
-                if (!matInfo.matches(clothingOrder.material_category))
-                    continue;
-
-                alreadyOwnedAmount++;
+                if (clothing_matches(ownedCount, clothingOrder))
+                    alreadyOwnedAmount += ownedCount.count;
             }
             int neededAmount = clothingOrder.needed_per_citizen - alreadyOwnedAmount;
 
@@ -508,33 +508,26 @@ static void find_needed_clothing_items()
 
 static void remove_available_clothing()
 {
-    for (auto& item : world->items.all)
+    //the ledger already groups unowned items, so this is one pass over a short list per order.
+    std::vector<ClothingCount> unowned;
+    getUnownedClothing(&unowned);
+    for (auto& clothingOrder : clothingOrders)
     {
-        //skip any owned items.
-        if (getOwner(item))
-            continue;
-
-        //again, for each item, find if any clothing order matches
-        for (auto& clothingOrder : clothingOrders)
+        for (auto& unownedCount : unowned)
         {
-            if (item->getType() != clothingOrder.itemType)
-                continue;
-            if (item->getSubtype() != clothingOrder.item_subtype)
-                continue;
-
-            MaterialInfo matInfo;
-            matInfo.decode(item);
-
-            if (!matInfo.matches(clothingOrder.material_category))
-                continue;
-
-            clothingOrder.total_needed_per_race[item->getMakerRace()] --;
+            if (clothing_matches(unownedCount, clothingOrder))
+                clothingOrder.total_needed_per_race[unownedCount.maker_race] -= unownedCount.count;
         }
     }
 }
 
 static void add_clothing_orders()
 {
+    //Annoyingly, the manager orders store the job type for clothing orders, and actual item type is left at -1;
+    const int signature = Job::ORDER_JOB_TYPE | Job::ORDER_ITEM_SUBTYPE | Job::ORDER_HIST_FIGURE;
+
+    std::vector<df::manager_order*> patterns;
+    std::vector<int> amounts;
     for (auto& clothingOrder : clothingOrders)
     {
         for (auto& orderNeeded : clothingOrder.total_needed_per_race)
@@ -546,43 +539,21 @@ static void add_clothing_orders()
             if (amount <= 0)
                 continue;
 
-            bool orderExistedAlready = false;
-            for (auto& managerOrder : world->manager_orders)
-            {
-                //Annoyingly, the manager orders store the job type for clothing orders, and actual item type is left at -1;
-                if (managerOrder->job_type != clothingOrder.jobType)
-                    continue;
-                if (managerOrder->item_subtype != clothingOrder.item_subtype)
-                    continue;
-                if (managerOrder->hist_figure_id != race)
-                    continue;
-
-                //We found a work order, that means we don't need to make a new one.
-                orderExistedAlready = true;
-                amount -= managerOrder->amount_left;
-                if (amount > 0)
-                {
-                    managerOrder->amount_left += amount;
-                    managerOrder->amount_total += amount;
-                }
-            }
-            //if it wasn't there, we need to make a new one.
-            if (!orderExistedAlready)
-            {
-                df::manager_order * newOrder = new df::manager_order();
-
-                newOrder->id = world->manager_order_next_id;
-                world->manager_order_next_id++;
-                newOrder->job_type = clothingOrder.jobType;
-                newOrder->item_subtype = clothingOrder.item_subtype;
-                newOrder->hist_figure_id = race;
-                newOrder->material_category = clothingOrder.material_category;
-                newOrder->amount_left = amount;
-                newOrder->amount_total = amount;
-                world->manager_orders.push_back(newOrder);
-            }
+            auto pattern = new df::manager_order();
+            pattern->job_type = clothingOrder.jobType;
+            pattern->item_subtype = clothingOrder.item_subtype;
+            pattern->hist_figure_id = race;
+            pattern->material_category = clothingOrder.material_category;
+            patterns.push_back(pattern);
+            amounts.push_back(amount);
         }
     }
+
+    //Existing work orders are topped up, and new ones made where there are none.
+    Job::ensureOrderAmounts(patterns, amounts, signature);
+
+    for (auto pattern : patterns)
+        delete pattern;
 }
 
 static void do_autoclothing()
@@ -23,11 +23,14 @@
 #include "modules/Buildings.h"
 
 #include <map>
+#include <vector>
 
 using namespace DFHack;
 using namespace df::enums;
 
 DFHACK_PLUGIN("building-hacks");
+// set while any workshop is registered; plugin_onupdate has nothing to dispatch otherwise
+DFHACK_PLUGIN_IS_ENABLED(is_enabled);
 REQUIRE_GLOBAL(world);
 
 struct graphic_tile //could do just 31x31 and be done, but it's nicer to have flexible imho.
@@ -52,18 +55,47 @@ struct workshop_hack_data
     //updateCallback:
     int skip_updates;
     int room_subset; //0 no, 1 yes, -1 default
+    //ids of buildings that were due an update this frame
+    std::vector<int32_t> due_updates;
 };
 typedef std::map<int32_t,workshop_hack_data> workshops_data_t;
 workshops_data_t hacked_workshops;
+//hacked_workshops indexed by custom type, so that vmethods don't have to search the map
+std::vector<workshop_hack_data*> workshop_defs;
 
 static void handle_update_action(color_ostream &out,df::building_workshopst*){};
 
 DEFINE_LUA_EVENT_1(onUpdateAction,handle_update_action,df::building_workshopst*);
+//all workshops of one custom type that were due an update this frame, as a list
+static DFHack::Lua::Notification onUpdateActionBatch_event;
 DFHACK_PLUGIN_LUA_EVENTS {
     DFHACK_LUA_EVENT(onUpdateAction),
+    DFHACK_LUA_EVENT(onUpdateActionBatch),
     DFHACK_LUA_END
 };
 
+static bool has_update_listeners()
+{
+    return onUpdateAction_event.get_listener_count() > 0 ||
+        onUpdateActionBatch_event.get_listener_count() > 0;
+}
+static void onUpdateActionBatch(color_ostream &out, int32_t custom_type, const std::vector<df::building_workshopst*> &workshops)
+{
+    for (auto workshop : workshops)
+        onUpdateAction(out, workshop);
+    if (auto state = onUpdateActionBatch_event.state_if_count())
+    {
+        Lua::Push(state, custom_type);
+        lua_createtable(state, workshops.size(), 0);
+        for (size_t i = 0; i < workshops.size(); i++)
+        {
+            Lua::PushDFObject(state, workshops[i]);
+            lua_rawseti(state, -2, i+1);
+        }
+        onUpdateActionBatch_event.invoke(out, 2);
+    }
+}
+
 struct work_hook : df::building_workshopst{
     typedef df::building_workshopst interpose_base;
 
@@ -71,9 +103,9 @@ struct work_hook : df::building_workshopst{
     {
         if (type == workshop_type::Custom)
         {
-            auto it=hacked_workshops.find(this->getCustomType());
-            if(it!=hacked_workshops.end())
-                return &(it->second);
+            int32_t custom_type = this->getCustomType();
+            if (custom_type >= 0 && size_t(custom_type) < workshop_defs.size())
+                return workshop_defs[custom_type];
         }
         return NULL;
     }
@@ -248,14 +280,12 @@ struct work_hook : df::building_workshopst{
     {
         if(auto def = find_def())
         {
-            if(def->skip_updates!=0 && is_fully_built())
+            if(def->skip_updates!=0 && is_fully_built() && has_update_listeners())
             {
-                if(world->frame_counter % def->skip_updates == 0)
-                {
-                    CoreSuspendClaimer suspend;
-                    color_ostream_proxy out(Core::getInstance().getConsole());
-                    onUpdateAction(out,this);
-                }
+                //offset by id so that buildings of one type don't all update on the same tick;
+                //the lua side is called from plugin_onupdate
+                if((int64_t(world->frame_counter) + id) % def->skip_updates == 0)
+                    def->due_updates.push_back(id);
             }
         }
         INTERPOSE_NEXT(updateAction)();
@@ -320,6 +350,42 @@ IMPLEMENT_VMETHOD_INTERPOSE(work_hook, drawBuilding);
 void clear_mapping()
 {
     hacked_workshops.clear();
+    workshop_defs.clear();
+    is_enabled = false;
+}
+static void update_def_index()
+{
+    workshop_defs.clear();
+    for (auto &it : hacked_workshops)
+    {
+        if (it.first < 0)
+            continue;
+        if (size_t(it.first) >= workshop_defs.size())
+            workshop_defs.resize(it.first + 1, NULL);
+        workshop_defs[it.first] = &it.second;
+    }
+    is_enabled = !hacked_workshops.empty();
+}
+static void dispatch_updates(color_ostream &out)
+{
+    std::vector<df::building_workshopst*> workshops;
+    for (auto &it : hacked_workshops)
+    {
+        workshop_hack_data &def = it.second;
+        if (def.due_updates.empty())
+            continue;
+        //the buildings might have been removed since they were queued
+        workshops.clear();
+        for (int32_t id : def.due_updates)
+        {
+            auto workshop = virtual_cast<df::building_workshopst>(df::building::find(id));
+            if (workshop && static_cast<work_hook*>(workshop)->find_def() == &def)
+                workshops.push_back(workshop);
+        }
+        def.due_updates.clear();
+        if (!workshops.empty())
+            onUpdateActionBatch(out, def.myType, workshops);
+    }
 }
 static void loadFrames(lua_State* L,workshop_hack_data& def,int stack_pos)
 {
@@ -415,6 +481,7 @@ static int addBuilding(lua_State* L)
     }
     newDefinition.room_subset=luaL_optinteger(L,10,-1);
     hacked_workshops[newDefinition.myType]=newDefinition;
+    update_def_index();
     return 0;
 }
 static void setPower(df::building_workshopst* workshop, int power_produced, int power_consumed)
@@ -482,6 +549,11 @@ DFhackCExport command_result plugin_onstatechange(color_ostream &out, state_chan
 
     return CR_OK;
 }
+DFhackCExport command_result plugin_onupdate ( color_ostream &out )
+{
+    dispatch_updates(out);
+    return CR_OK;
+}
 DFhackCExport command_result plugin_init ( color_ostream &out, std::vector <PluginCommand> &commands)
 {
     enable_hooks(true);
@@ -327,6 +327,9 @@ command_result changelayer (color_ostream &out, std::vector <std::string> & para
         }
     }
 
+    // cached map geology still has the old layer materials
+    MapExtras::GeologyInfo::invalidate();
+
     out.print("Done.\n");
 
     // Give control back to DF.
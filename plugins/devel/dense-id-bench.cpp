@@ -0,0 +1,141 @@
+// Compares id lookups through the dense id tables with plain binary searches
+// on a synthetic instance vector, before and after removing some entries.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Core.h"
+#include "Console.h"
+#include "Export.h"
+#include "MiscUtils.h"
+#include "PluginManager.h"
+
+using std::string;
+using std::vector;
+using namespace DFHack;
+
+DFHACK_PLUGIN("dense-id-bench");
+
+command_result dense_id_bench (color_ostream &out, vector <string> & parameters);
+
+DFhackCExport command_result plugin_init ( color_ostream &out, std::vector <PluginCommand> &commands)
+{
+    commands.push_back(PluginCommand(
+        "dense-id-bench", "Benchmark dense id tables against binary search.",
+        dense_id_bench, false,
+        "  dense-id-bench [count] [lookups]\n"
+        "    Looks up random ids in a vector of count objects (default 1000000)\n"
+        "    with and without a dense id table.\n"
+    ));
+    return CR_OK;
+}
+
+namespace {
+    struct bench_object
+    {
+        int32_t id;
+        int32_t payload[7];
+    };
+}
+
+static int binsearch_plain(const vector<bench_object*> &vec, int32_t key)
+{
+    int min = -1, max = (int)vec.size();
+    for (;;)
+    {
+        int mid = (min + max)>>1;
+        if (mid == min)
+            return -1;
+        int32_t midv = vec[mid]->id;
+        if (midv == key)
+            return mid;
+        else if (midv < key)
+            min = mid;
+        else
+            max = mid;
+    }
+}
+
+template<typename F>
+static double time_lookups(const vector<int32_t> &keys, size_t *found, F lookup)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t hits = 0;
+    for (int32_t key : keys)
+    {
+        if (lookup(key) >= 0)
+            hits++;
+    }
+    auto end = std::chrono::steady_clock::now();
+    *found = hits;
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static void run_round(color_ostream &out, const char *label,
+                      const vector<bench_object*> &vec, const vector<int32_t> &keys)
+{
+    size_t plain_hits = 0, dense_hits = 0;
+    double plain = time_lookups(keys, &plain_hits, [&](int32_t key) {
+        return binsearch_plain(vec, key);
+    });
+    double dense = time_lookups(keys, &dense_hits, [&](int32_t key) {
+        return binsearch_index(vec, &bench_object::id, key);
+    });
+    out.print("%s: binary search %.1f Mlookups/s, dense table %.1f Mlookups/s%s\n",
+              label, keys.size() / plain / 1e6, keys.size() / dense / 1e6,
+              plain_hits == dense_hits ? "" : " (RESULTS DIFFER)");
+}
+
+command_result dense_id_bench (color_ostream &out, vector <string> & parameters)
+{
+    size_t count = 1000000, lookups = 4000000;
+    if (parameters.size() > 0)
+        count = std::max<long>(atol(parameters[0].c_str()), DENSE_ID_MIN_SIZE);
+    if (parameters.size() > 1)
+        lookups = std::max<long>(atol(parameters[1].c_str()), 1);
+
+    // Objects are allocated in a shuffled order so that the vector points all
+    // over the heap, like DF's own instance vectors.
+    std::mt19937 rng(12345);
+    vector<bench_object> storage(count);
+    vector<bench_object*> vec(count);
+    vector<size_t> slots(count);
+    for (size_t i = 0; i < count; i++)
+        slots[i] = i;
+    std::shuffle(slots.begin(), slots.end(), rng);
+    for (size_t i = 0; i < count; i++)
+    {
+        vec[i] = &storage[slots[i]];
+        vec[i]->id = int32_t(i * 2);
+    }
+
+    std::uniform_int_distribution<int32_t> dist(0, int32_t(count * 2));
+    vector<int32_t> keys(lookups);
+    for (auto &key : keys)
+        key = dist(rng);
+
+    // Tables are only kept up to date while the core is suspended.
+    CoreSuspender suspend;
+    register_dense_id_vector(&vec);
+
+    run_round(out, "fresh", vec, keys);
+
+    // Remove a few percent of the entries, which makes lookups past them
+    // step down from the index in the table.
+    vector<bench_object*> kept;
+    kept.reserve(vec.size());
+    for (size_t i = 0; i < vec.size(); i++)
+    {
+        if (rng() % 32 != 0)
+            kept.push_back(vec[i]);
+    }
+    vec.swap(kept);
+    run_round(out, "after removals", vec, keys);
+
+    unregister_dense_id_vector(&vec);
+    return CR_OK;
+}
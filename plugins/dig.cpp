@@ -1,7 +1,9 @@
 #include <vector>
 #include <cstdio>
 #include <cstdlib>
-#include <stack>
+#include <cstring>
+#include <functional>
+#include <map>
 #include <string>
 #include <cmath>
 
@@ -20,7 +22,6 @@
 
 using std::vector;
 using std::string;
-using std::stack;
 using namespace DFHack;
 using namespace df::enums;
 
@@ -1032,6 +1033,338 @@ command_result digexp (color_ostream &out, vector <string> & parameters)
     return CR_OK;
 }
 
+/*
+ * digv and digl flood fill a vein or layer one map block at a time. Each block
+ * gets 16x16 masks of the tiles that match the material and of the walls among
+ * them, and the flood spreads through a block with bitwise operations on those
+ * masks before handing its edges to the neighbouring blocks.
+ */
+namespace {
+    // Bit x of row y is tile (x,y) of a block, like block_square_event_mineralst::tile_bitmask
+    struct tile_rows {
+        uint16_t rows[16];
+
+        tile_rows() { memset(rows, 0, sizeof(rows)); }
+
+        bool get(int x, int y) const { return (rows[y] >> x) & 1; }
+        bool any() const
+        {
+            for (int y = 0; y < 16; y++)
+                if (rows[y])
+                    return true;
+            return false;
+        }
+    };
+
+    struct flood_block {
+        MapExtras::Block *block;
+        tile_rows matching; // tiles of the material being dug, walls or not
+        tile_rows allowed;  // matching walls that the flood may enter
+        tile_rows filled;
+        bool queued;
+
+        flood_block() : block(NULL), queued(false) {}
+    };
+
+    class block_flood {
+    public:
+        // Fills in the matching tiles and the walls of a block
+        typedef std::function<void(MapExtras::Block *, tile_rows &, tile_rows &)> classifier;
+
+        block_flood(MapExtras::MapCache &mc, classifier classify, bool updown)
+            : mc(mc), classify(classify), updown(updown)
+        {
+            Maps::getSize(x_max, y_max, z_max);
+        }
+
+        void seed(df::coord tile)
+        {
+            add(df::coord(tile.x >> 4, tile.y >> 4, tile.z), tile.y & 15, 1 << (tile.x & 15));
+        }
+
+        void run();
+        void designate(int32_t priority, bool undo);
+
+    private:
+        MapExtras::MapCache &mc;
+        classifier classify;
+        bool updown;
+        uint32_t x_max, y_max, z_max;
+
+        std::map<df::coord, flood_block> blocks;
+        std::vector<df::coord> queue;
+
+        flood_block *get(df::coord bpos);
+        flood_block *find(df::coord bpos);
+        void add(df::coord bpos, int y, uint16_t bits);
+        void add_tile(df::coord bpos, int x, int y);
+        void expand(flood_block &fb);
+        void spread(df::coord bpos, flood_block &fb);
+    };
+}
+
+flood_block *block_flood::get(df::coord bpos)
+{
+    if (bpos.x < 0 || bpos.y < 0 || bpos.z < 0 ||
+        bpos.x >= int32_t(x_max) || bpos.y >= int32_t(y_max) || bpos.z >= int32_t(z_max))
+        return NULL;
+
+    auto it = blocks.find(bpos);
+    if (it != blocks.end())
+        return &it->second;
+
+    flood_block &fb = blocks[bpos];
+    MapExtras::Block *b = mc.BlockAt(bpos);
+    if (!b || !b->is_valid())
+        return &fb;
+
+    fb.block = b;
+    tile_rows walls;
+    classify(b, fb.matching, walls);
+
+    // don't dig the map borders
+    uint16_t border = 0xFFFF;
+    if (bpos.x == 0)
+        border &= ~1;
+    if (bpos.x == int32_t(x_max) - 1)
+        border &= ~0x8000;
+    for (int y = 0; y < 16; y++)
+        fb.allowed.rows[y] = fb.matching.rows[y] & walls.rows[y] & border;
+    if (bpos.y == 0)
+        fb.allowed.rows[0] = 0;
+    if (bpos.y == int32_t(y_max) - 1)
+        fb.allowed.rows[15] = 0;
+
+    return &fb;
+}
+
+flood_block *block_flood::find(df::coord bpos)
+{
+    auto it = blocks.find(bpos);
+    return it != blocks.end() ? &it->second : NULL;
+}
+
+void block_flood::add(df::coord bpos, int y, uint16_t bits)
+{
+    flood_block *fb = get(bpos);
+    if (!fb)
+        return;
+    bits &= fb->allowed.rows[y] & ~fb->filled.rows[y];
+    if (!bits)
+        return;
+    fb->filled.rows[y] |= bits;
+    if (!fb->queued)
+    {
+        fb->queued = true;
+        queue.push_back(bpos);
+    }
+}
+
+// x and y may be one tile outside of the block
+void block_flood::add_tile(df::coord bpos, int x, int y)
+{
+    if (x < 0) { bpos.x--; x += 16; }
+    else if (x > 15) { bpos.x++; x -= 16; }
+    if (y < 0) { bpos.y--; y += 16; }
+    else if (y > 15) { bpos.y++; y -= 16; }
+    add(bpos, y, 1 << x);
+}
+
+void block_flood::expand(flood_block &fb)
+{
+    uint16_t *f = fb.filled.rows;
+    const uint16_t *allowed = fb.allowed.rows;
+    bool changed;
+    do
+    {
+        changed = false;
+        uint16_t spread[16];
+        for (int y = 0; y < 16; y++)
+            spread[y] = f[y] | (f[y] << 1) | (f[y] >> 1);
+        for (int y = 0; y < 16; y++)
+        {
+            uint16_t row = spread[y];
+            if (y > 0)
+                row |= spread[y-1];
+            if (y < 15)
+                row |= spread[y+1];
+            row &= allowed[y];
+            if (row != f[y])
+            {
+                f[y] = row;
+                changed = true;
+            }
+        }
+    } while (changed);
+}
+
+void block_flood::spread(df::coord bpos, flood_block &fb)
+{
+    const uint16_t *f = fb.filled.rows;
+
+    // rows above and below the block, with one extra tile on each side
+    uint32_t north = uint32_t(f[0]) << 1, south = uint32_t(f[15]) << 1;
+    north |= (north << 1) | (north >> 1);
+    south |= (south << 1) | (south >> 1);
+    add(df::coord(bpos.x, bpos.y - 1, bpos.z), 15, uint16_t(north >> 1));
+    add(df::coord(bpos.x, bpos.y + 1, bpos.z), 0, uint16_t(south >> 1));
+    if (north & 1) add_tile(bpos, -1, -1);
+    if (north & (1 << 17)) add_tile(bpos, 16, -1);
+    if (south & 1) add_tile(bpos, -1, 16);
+    if (south & (1 << 17)) add_tile(bpos, 16, 16);
+
+    // columns left and right of the block; the corners were done above
+    uint32_t west = 0, east = 0;
+    for (int y = 0; y < 16; y++)
+    {
+        west |= uint32_t(f[y] & 1) << y;
+        east |= uint32_t(f[y] >> 15) << y;
+    }
+    west |= (west << 1) | (west >> 1);
+    east |= (east << 1) | (east >> 1);
+    for (int y = 0; y < 16; y++)
+    {
+        if (west & (1 << y))
+            add(df::coord(bpos.x - 1, bpos.y, bpos.z), y, 0x8000);
+        if (east & (1 << y))
+            add(df::coord(bpos.x + 1, bpos.y, bpos.z), y, 1);
+    }
+
+    if (updown)
+    {
+        for (int y = 0; y < 16; y++)
+        {
+            if (!f[y])
+                continue;
+            add(df::coord(bpos.x, bpos.y, bpos.z + 1), y, f[y]);
+            add(df::coord(bpos.x, bpos.y, bpos.z - 1), y, f[y]);
+        }
+    }
+}
+
+void block_flood::run()
+{
+    while (!queue.empty())
+    {
+        df::coord bpos = queue.back();
+        queue.pop_back();
+        flood_block &fb = blocks[bpos];
+        fb.queued = false;
+        expand(fb);
+        spread(bpos, fb);
+    }
+}
+
+/*
+ * Filled tiles are dug, or get stairs where a matching tile is above or below.
+ * In updown mode, matching tiles next to a filled tile on another level that
+ * could not be filled themselves (e.g. floors) also get the other half of the
+ * stairs.
+ */
+void block_flood::designate(int32_t priority, bool undo)
+{
+    for (auto it = blocks.begin(); it != blocks.end(); ++it)
+    {
+        df::coord bpos = it->first;
+        flood_block &fb = it->second;
+        if (!fb.block)
+            continue;
+
+        flood_block *above = NULL, *below = NULL;
+        if (updown)
+        {
+            above = find(df::coord(bpos.x, bpos.y, bpos.z + 1));
+            below = find(df::coord(bpos.x, bpos.y, bpos.z - 1));
+        }
+
+        for (int y = 0; y < 16; y++)
+        {
+            uint16_t stairs = 0;
+            if (above)
+                stairs |= above->filled.rows[y];
+            if (below)
+                stairs |= below->filled.rows[y];
+            stairs &= fb.matching.rows[y] & ~fb.filled.rows[y];
+
+            uint16_t tiles = fb.filled.rows[y] | stairs;
+            for (int x = 0; tiles; x++, tiles >>= 1)
+            {
+                if (!(tiles & 1))
+                    continue;
+
+                df::coord2d pos(x, y);
+                df::tile_designation des = fb.block->DesignationAt(pos);
+                if (fb.filled.get(x, y))
+                {
+                    bool up = above && above->matching.get(x, y);
+                    bool down = below && below->matching.get(x, y);
+                    if (up && down)
+                        des.bits.dig = tile_dig_designation::UpDownStair;
+                    else if (down)
+                        des.bits.dig = tile_dig_designation::DownStair;
+                    else if (up)
+                        des.bits.dig = tile_dig_designation::UpStair;
+                    else if (des.bits.dig == tile_dig_designation::No)
+                        des.bits.dig = tile_dig_designation::Default;
+                }
+                else
+                {
+                    // the tile above is dug as a down stair, the one below as an up stair
+                    bool from_above = above && above->filled.get(x, y);
+                    bool from_below = below && below->filled.get(x, y);
+                    if (from_above && from_below)
+                        des.bits.dig = tile_dig_designation::UpDownStair;
+                    else if (from_above)
+                        des.bits.dig = (des.bits.dig == tile_dig_designation::DownStair)
+                            ? tile_dig_designation::UpDownStair : tile_dig_designation::UpStair;
+                    else
+                        des.bits.dig = (des.bits.dig == tile_dig_designation::UpStair)
+                            ? tile_dig_designation::UpDownStair : tile_dig_designation::DownStair;
+                }
+                // undo mode: clear designation
+                if (undo)
+                    des.bits.dig = tile_dig_designation::No;
+                fb.block->setDesignationAt(pos, des, priority);
+            }
+        }
+    }
+}
+
+// Tiles where mat is the vein material; with -1, tiles that are in no vein
+static void vein_mask(df::map_block *block, int16_t mat, tile_rows &mask)
+{
+    std::vector<df::block_square_event_mineralst *> veins;
+    Maps::SortBlockEvents(block, &veins);
+
+    // later events take precedence, as in MapCache
+    for (int y = 0; y < 16; y++)
+        mask.rows[y] = (mat == -1) ? 0xFFFF : 0;
+    for (size_t i = 0; i < veins.size(); i++)
+    {
+        for (int y = 0; y < 16; y++)
+        {
+            if (veins[i]->inorganic_mat == mat)
+                mask.rows[y] |= veins[i]->tile_bitmask[y];
+            else
+                mask.rows[y] &= ~veins[i]->tile_bitmask[y];
+        }
+    }
+}
+
+static void wall_mask(MapExtras::Block *block, tile_rows &mask)
+{
+    for (int y = 0; y < 16; y++)
+    {
+        uint16_t row = 0;
+        for (int x = 0; x < 16; x++)
+        {
+            if (isWallTerrain(block->tiletypeAt(df::coord2d(x, y))))
+                row |= 1 << x;
+        }
+        mask.rows[y] = row;
+    }
+}
+
 command_result digvx (color_ostream &out, vector <string> & parameters)
 {
     // HOTKEY COMMAND: CORE ALREADY SUSPENDED
@@ -1091,114 +1424,15 @@ command_result digv (color_ostream &out, vector <string> & parameters)
         return CR_FAILURE;
     }
     con.print("%d/%d/%d tiletype: %d, veinmat: %d, designation: 0x%x ... DIGGING!\n", cx,cy,cz, tt, veinmat, des.whole);
-    stack <DFHack::DFCoord> flood;
-    flood.push(xy);
 
-    while( !flood.empty() )
-    {
-        DFHack::DFCoord current = flood.top();
-        flood.pop();
-        if (MCache->tagAt(current))
-            continue;
-        int16_t vmat2 = MCache->veinMaterialAt(current);
-        tt = MCache->tiletypeAt(current);
-        if(!DFHack::isWallTerrain(tt))
-            continue;
-        if(vmat2!=veinmat)
-            continue;
+    block_flood flood(*MCache, [veinmat](MapExtras::Block *b, tile_rows &matching, tile_rows &walls) {
+        vein_mask(b->getRaw(), veinmat, matching);
+        wall_mask(b, walls);
+    }, updown);
+    flood.seed(xy);
+    flood.run();
+    flood.designate(priority, false);
 
-        // found a good tile, dig+unset material
-        df::tile_designation des = MCache->designationAt(current);
-        df::tile_designation des_minus;
-        df::tile_designation des_plus;
-        des_plus.whole = des_minus.whole = 0;
-        int16_t vmat_minus = -1;
-        int16_t vmat_plus = -1;
-        bool below = 0;
-        bool above = 0;
-        if(updown)
-        {
-            if(MCache->testCoord(current-1))
-            {
-                below = 1;
-                des_minus = MCache->designationAt(current-1);
-                vmat_minus = MCache->veinMaterialAt(current-1);
-            }
-
-            if(MCache->testCoord(current+1))
-            {
-                above = 1;
-                des_plus = MCache->designationAt(current+1);
-                vmat_plus = MCache->veinMaterialAt(current+1);
-            }
-        }
-        if(MCache->testCoord(current))
-        {
-            MCache->setTagAt(current, 1);
-
-            if(current.x < int32_t(tx_max) - 2)
-            {
-                flood.push(DFHack::DFCoord(current.x + 1, current.y, current.z));
-                if(current.y < int32_t(ty_max) - 2)
-                {
-                    flood.push(DFHack::DFCoord(current.x + 1, current.y + 1,current.z));
-                    flood.push(DFHack::DFCoord(current.x, current.y + 1,current.z));
-                }
-                if(current.y > 1)
-                {
-                    flood.push(DFHack::DFCoord(current.x + 1, current.y - 1,current.z));
-                    flood.push(DFHack::DFCoord(current.x, current.y - 1,current.z));
-                }
-            }
-            if(current.x > 1)
-            {
-                flood.push(DFHack::DFCoord(current.x - 1, current.y,current.z));
-                if(current.y < int32_t(ty_max) - 2)
-                {
-                    flood.push(DFHack::DFCoord(current.x - 1, current.y + 1,current.z));
-                    flood.push(DFHack::DFCoord(current.x, current.y + 1,current.z));
-                }
-                if(current.y > 1)
-                {
-                    flood.push(DFHack::DFCoord(current.x - 1, current.y - 1,current.z));
-                    flood.push(DFHack::DFCoord(current.x, current.y - 1,current.z));
-                }
-            }
-            if(updown)
-            {
-                if(current.z > 0 && below && vmat_minus == vmat2)
-                {
-                    flood.push(current-1);
-
-                    if(des_minus.bits.dig == tile_dig_designation::DownStair)
-                        des_minus.bits.dig = tile_dig_designation::UpDownStair;
-                    else
-                        des_minus.bits.dig = tile_dig_designation::UpStair;
-                    MCache->setDesignationAt(current-1,des_minus,priority);
-
-                    des.bits.dig = tile_dig_designation::DownStair;
-                }
-                if(current.z < int32_t(z_max) - 1 && above && vmat_plus == vmat2)
-                {
-                    flood.push(current+ 1);
-
-                    if(des_plus.bits.dig == tile_dig_designation::UpStair)
-                        des_plus.bits.dig = tile_dig_designation::UpDownStair;
-                    else
-                        des_plus.bits.dig = tile_dig_designation::DownStair;
-                    MCache->setDesignationAt(current+1,des_plus,priority);
-
-                    if(des.bits.dig == tile_dig_designation::DownStair)
-                        des.bits.dig = tile_dig_designation::UpDownStair;
-                    else
-                        des.bits.dig = tile_dig_designation::UpStair;
-                }
-            }
-            if(des.bits.dig == tile_dig_designation::No)
-                des.bits.dig = tile_dig_designation::Default;
-            MCache->setDesignationAt(current,des,priority);
-        }
-    }
     MCache->WriteAll();
     delete MCache;
     return CR_OK;
@@ -1213,12 +1447,6 @@ command_result diglx (color_ostream &out, vector <string> & parameters)
     return digl(out,lol);
 }
 
-// TODO:
-// digl and digv share the longish floodfill code and only use different conditions
-// to check if a tile should be marked for digging or not.
-// to make the plugin a bit smaller and cleaner a main execute method would be nice
-// (doing the floodfill stuff and do the checks dependin on whether called in
-// "vein" or "layer" mode)
 command_result digl (color_ostream &out, vector <string> & parameters)
 {
     // HOTKEY COMMAND: CORE ALREADY SUSPENDED
@@ -1279,143 +1507,29 @@ command_result digl (color_ostream &out, vector <string> & parameters)
         return CR_FAILURE;
     }
     con.print("%d/%d/%d tiletype: %d, basemat: %d, designation: 0x%x ... DIGGING!\n", cx,cy,cz, tt, basemat, des.whole);
-    stack <DFHack::DFCoord> flood;
-    flood.push(xy);
-
-    int i = 0;
-    while( !flood.empty() )
-    {
-        DFHack::DFCoord current = flood.top();
-        flood.pop();
-        if (MCache->tagAt(current))
-            continue;
-        int16_t vmat2 = MCache->veinMaterialAt(current);
-        int16_t bmat2 = MCache->layerMaterialAt(current);
-        tt = MCache->tiletypeAt(current);
-
-        if(!DFHack::isWallTerrain(tt))
-            continue;
-        if(vmat2!=-1)
-            continue;
-        if(bmat2!=basemat)
-            continue;
-
-        // don't dig out LAVA_STONE or MAGMA (semi-molten rock) accidentally
-        if(    tileMaterial(tt)!=tiletype_material::STONE
-            && tileMaterial(tt)!=tiletype_material::SOIL)
-            continue;
 
-        // found a good tile, dig+unset material
-        df::tile_designation des = MCache->designationAt(current);
-        df::tile_designation des_minus;
-        df::tile_designation des_plus;
-        des_plus.whole = des_minus.whole = 0;
-        int16_t vmat_minus = -1;
-        int16_t vmat_plus = -1;
-        int16_t bmat_minus = -1;
-        int16_t bmat_plus = -1;
-        df::tiletype tt_minus;
-        df::tiletype tt_plus;
-
-        if(MCache->testCoord(current))
+    block_flood flood(*MCache, [basemat](MapExtras::Block *b, tile_rows &matching, tile_rows &walls) {
+        vein_mask(b->getRaw(), -1, matching);
+        for (int y = 0; y < 16; y++)
         {
-            MCache->setTagAt(current, 1);
-            if(current.x < int32_t(tx_max) - 2)
-            {
-                flood.push(DFHack::DFCoord(current.x + 1, current.y, current.z));
-                if(current.y < int32_t(ty_max) - 2)
-                {
-                    flood.push(DFHack::DFCoord(current.x + 1, current.y + 1, current.z));
-                    flood.push(DFHack::DFCoord(current.x, current.y + 1, current.z));
-                }
-                if(current.y > 1)
-                {
-                    flood.push(DFHack::DFCoord(current.x + 1, current.y - 1, current.z));
-                    flood.push(DFHack::DFCoord(current.x, current.y - 1, current.z));
-                }
-            }
-            if(current.x > 1)
-            {
-                flood.push(DFHack::DFCoord(current.x - 1, current.y, current.z));
-                if(current.y < int32_t(ty_max) - 2)
-                {
-                    flood.push(DFHack::DFCoord(current.x - 1, current.y + 1, current.z));
-                    flood.push(DFHack::DFCoord(current.x, current.y + 1, current.z));
-                }
-                if(current.y > 1)
-                {
-                    flood.push(DFHack::DFCoord(current.x - 1, current.y - 1, current.z));
-                    flood.push(DFHack::DFCoord(current.x, current.y - 1, current.z));
-                }
-            }
-            if(updown)
+            for (int x = 0; x < 16; x++)
             {
-                bool below = 0;
-                bool above = 0;
-                if(MCache->testCoord(current-1))
-                {
-                    //below = 1;
-                    des_minus = MCache->designationAt(current-1);
-                    vmat_minus = MCache->veinMaterialAt(current-1);
-                    bmat_minus = MCache->layerMaterialAt(current-1);
-                    tt_minus = MCache->tiletypeAt(current-1);
-                    if (   tileMaterial(tt_minus)==tiletype_material::STONE
-                        || tileMaterial(tt_minus)==tiletype_material::SOIL)
-                        below = 1;
-                }
-                if(MCache->testCoord(current+1))
-                {
-                    //above = 1;
-                    des_plus = MCache->designationAt(current+1);
-                    vmat_plus = MCache->veinMaterialAt(current+1);
-                    bmat_plus = MCache->layerMaterialAt(current+1);
-                    tt_plus = MCache->tiletypeAt(current+1);
-                    if (   tileMaterial(tt_plus)==tiletype_material::STONE
-                        || tileMaterial(tt_plus)==tiletype_material::SOIL)
-                        above = 1;
-                }
-                if(current.z > 0 && below && vmat_minus == -1 && bmat_minus == basemat)
-                {
-                    flood.push(current-1);
-
-                    if(des_minus.bits.dig == tile_dig_designation::DownStair)
-                        des_minus.bits.dig = tile_dig_designation::UpDownStair;
-                    else
-                        des_minus.bits.dig = tile_dig_designation::UpStair;
-                    // undo mode: clear designation
-                    if(undo)
-                        des_minus.bits.dig = tile_dig_designation::No;
-                    MCache->setDesignationAt(current-1,des_minus,priority);
-
-                    des.bits.dig = tile_dig_designation::DownStair;
-                }
-                if(current.z < int32_t(z_max) - 1 && above && vmat_plus == -1 && bmat_plus == basemat)
-                {
-                    flood.push(current+ 1);
-
-                    if(des_plus.bits.dig == tile_dig_designation::UpStair)
-                        des_plus.bits.dig = tile_dig_designation::UpDownStair;
-                    else
-                        des_plus.bits.dig = tile_dig_designation::DownStair;
-                    // undo mode: clear designation
-                    if(undo)
-                        des_plus.bits.dig = tile_dig_designation::No;
-                    MCache->setDesignationAt(current+1,des_plus,priority);
-
-                    if(des.bits.dig == tile_dig_designation::DownStair)
-                        des.bits.dig = tile_dig_designation::UpDownStair;
-                    else
-                        des.bits.dig = tile_dig_designation::UpStair;
-                }
+                if (!matching.get(x, y))
+                    continue;
+                df::coord2d pos(x, y);
+                // don't dig out LAVA_STONE or MAGMA (semi-molten rock) accidentally
+                auto tm = tileMaterial(b->tiletypeAt(pos));
+                if ((tm != tiletype_material::STONE && tm != tiletype_material::SOIL)
+                    || b->layerMaterialAt(pos) != basemat)
+                    matching.rows[y] &= ~(1 << x);
             }
-            if(des.bits.dig == tile_dig_designation::No)
-                des.bits.dig = tile_dig_designation::Default;
-            // undo mode: clear designation
-            if(undo)
-                des.bits.dig = tile_dig_designation::No;
-            MCache->setDesignationAt(current,des,priority);
         }
-    }
+        wall_mask(b, walls);
+    }, updown);
+    flood.seed(xy);
+    flood.run();
+    flood.designate(priority, undo);
+
     MCache->WriteAll();
     delete MCache;
     return CR_OK;
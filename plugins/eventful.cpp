@@ -15,6 +15,7 @@
 #include "df/item_actual.h"
 #include "df/job.h"
 #include "df/proj_itemst.h"
+#include "df/proj_list_link.h"
 #include "df/proj_unitst.h"
 #include "df/reaction.h"
 #include "df/reaction_reagent_itemst.h"
@@ -26,6 +27,7 @@
 
 #include "modules/EventManager.h"
 
+#include <algorithm>
 #include <string.h>
 #include <stdexcept>
 
@@ -36,6 +38,8 @@ using namespace DFHack;
 using namespace df::enums;
 
 DFHACK_PLUGIN("eventful");
+// set while any hook is applied, which is when plugin_onupdate has work to do
+DFHACK_PLUGIN_IS_ENABLED(is_enabled);
 REQUIRE_GLOBAL(gps);
 REQUIRE_GLOBAL(world);
 REQUIRE_GLOBAL(ui);
@@ -82,17 +86,58 @@ static std::map<df::reaction_product*, ProductInfo*> products;
  * Hooks
  */
 
-DEFINE_LUA_EVENT_NH_2(onWorkshopFillSidebarMenu, df::building_actual*, bool*);
-DEFINE_LUA_EVENT_NH_1(postWorkshopFillSidebarMenu, df::building_actual*);
+static bool hooks_enabled = false;
+// set when a hook lost its last listener, but could not be removed yet
+static bool hooks_dirty = false;
+static void update_hooks(bool allow_remove = true);
 
-DEFINE_LUA_EVENT_NH_7(onReactionCompleting, df::reaction*, df::reaction_product_itemst*, df::unit *, std::vector<df::item*> *, std::vector<df::reaction_reagent*> *, std::vector<df::item*> *, bool *);
-DEFINE_LUA_EVENT_NH_6(onReactionComplete, df::reaction*, df::reaction_product_itemst*, df::unit *, std::vector<df::item*> *, std::vector<df::reaction_reagent*> *, std::vector<df::item*> *);
-DEFINE_LUA_EVENT_NH_5(onItemContaminateWound, df::item_actual*, df::unit*, df::unit_wound*, uint8_t, int16_t);
+/*
+ * An event that feeds a vmethod hook. The hooks are only applied while one of
+ * their events has a listener, so that e.g. projectiles cost nothing extra
+ * when no script is interested in them.
+ */
+template<typename... Args>
+class hooked_event : public Lua::Notification {
+public:
+    bool has_listeners() { return get_listener_count() > 0; }
+
+    void operator()(color_ostream &out, Args... args)
+    {
+        if (auto state = state_if_count())
+        {
+            int dummy[] = { 0, (Lua::Push(state, args), 0)... };
+            (void)dummy;
+            invoke(out, sizeof...(Args));
+        }
+    }
+
+    void on_count_changed(int new_cnt, int delta)
+    {
+        bool had_listeners = has_listeners();
+        Lua::Notification::on_count_changed(new_cnt, delta);
+        // listeners may unsubscribe from inside the hooked vmethod, which would
+        // still call INTERPOSE_NEXT afterwards, so only removal is deferred
+        if (had_listeners != has_listeners())
+            update_hooks(false);
+    }
+};
+
+static hooked_event<df::building_actual*, bool*> onWorkshopFillSidebarMenu_event;
+static hooked_event<df::building_actual*> postWorkshopFillSidebarMenu_event;
+
+static hooked_event<df::reaction*, df::reaction_product_itemst*, df::unit *, std::vector<df::item*> *, std::vector<df::reaction_reagent*> *, std::vector<df::item*> *, bool *> onReactionCompleting_event;
+static hooked_event<df::reaction*, df::reaction_product_itemst*, df::unit *, std::vector<df::item*> *, std::vector<df::reaction_reagent*> *, std::vector<df::item*> *> onReactionComplete_event;
+static hooked_event<df::item_actual*, df::unit*, df::unit_wound*, uint8_t, int16_t> onItemContaminateWound_event;
 //projectiles
-DEFINE_LUA_EVENT_NH_2(onProjItemCheckImpact, df::proj_itemst*, bool);
-DEFINE_LUA_EVENT_NH_1(onProjItemCheckMovement, df::proj_itemst*);
-DEFINE_LUA_EVENT_NH_2(onProjUnitCheckImpact, df::proj_unitst*, bool);
-DEFINE_LUA_EVENT_NH_1(onProjUnitCheckMovement, df::proj_unitst*);
+static hooked_event<df::proj_itemst*, bool> onProjItemCheckImpact_event;
+static hooked_event<df::proj_itemst*> onProjItemCheckMovement_event;
+static hooked_event<df::proj_unitst*, bool> onProjUnitCheckImpact_event;
+static hooked_event<df::proj_unitst*> onProjUnitCheckMovement_event;
+//projectiles that moved this tick, delivered once per tick as a list
+static hooked_event<> onProjItemCheckMovementBatch_event;
+static hooked_event<> onProjUnitCheckMovementBatch_event;
+static std::vector<int32_t> moved_proj_items;
+static std::vector<int32_t> moved_proj_units;
 //event manager
 DEFINE_LUA_EVENT_NH_1(onBuildingCreatedDestroyed, int32_t);
 DEFINE_LUA_EVENT_NH_1(onJobInitiated, df::job*);
@@ -118,6 +163,8 @@ DFHACK_PLUGIN_LUA_EVENTS {
     DFHACK_LUA_EVENT(onProjItemCheckMovement),
     DFHACK_LUA_EVENT(onProjUnitCheckImpact),
     DFHACK_LUA_EVENT(onProjUnitCheckMovement),
+    DFHACK_LUA_EVENT(onProjItemCheckMovementBatch),
+    DFHACK_LUA_EVENT(onProjUnitCheckMovementBatch),
     /*  event manager events */
     DFHACK_LUA_EVENT(onBuildingCreatedDestroyed),
     DFHACK_LUA_EVENT(onConstructionCreatedDestroyed),
@@ -253,10 +300,10 @@ struct workshop_hook : df::building_workshopst{
         CoreSuspendClaimer suspend;
         color_ostream_proxy out(Core::getInstance().getConsole());
         bool call_native=true;
-        onWorkshopFillSidebarMenu(out,this,&call_native);
+        onWorkshopFillSidebarMenu_event(out,this,&call_native);
         if(call_native)
             INTERPOSE_NEXT(fillSidebarMenu)();
-        postWorkshopFillSidebarMenu(out,this);
+        postWorkshopFillSidebarMenu_event(out,this);
     }
 };
 IMPLEMENT_VMETHOD_INTERPOSE(workshop_hook, fillSidebarMenu);
@@ -268,10 +315,10 @@ struct furnace_hook : df::building_furnacest{
         CoreSuspendClaimer suspend;
         color_ostream_proxy out(Core::getInstance().getConsole());
         bool call_native=true;
-        onWorkshopFillSidebarMenu(out,this,&call_native);
+        onWorkshopFillSidebarMenu_event(out,this,&call_native);
         if(call_native)
             INTERPOSE_NEXT(fillSidebarMenu)();
-        postWorkshopFillSidebarMenu(out,this);
+        postWorkshopFillSidebarMenu_event(out,this);
     }
 };
 IMPLEMENT_VMETHOD_INTERPOSE(furnace_hook, fillSidebarMenu);
@@ -289,16 +336,16 @@ struct product_hook : item_product {
          int32_t quantity, df::job_skill skill,
          int32_t quality, df::historical_entity *entity,  df::world_site *site, std::vector<void *> *unk2)
     ) {
-        color_ostream_proxy out(Core::getInstance().getConsole());
-        auto product = products[this];
-        if ( !product ) {
+        auto it = products.find(this);
+        if ( it == products.end() || !it->second ) {
             INTERPOSE_NEXT(produce)(unit, out_products, out_items, in_reag, in_items, quantity, skill, quality, entity, site, unk2);
             return;
         }
-        df::reaction* this_reaction=product->react;
+        df::reaction* this_reaction=it->second->react;
         CoreSuspendClaimer suspend;
+        color_ostream_proxy out(Core::getInstance().getConsole());
         bool call_native=true;
-        onReactionCompleting(out,this_reaction,(df::reaction_product_itemst*)this,unit,in_items,in_reag,out_items,&call_native);
+        onReactionCompleting_event(out,this_reaction,(df::reaction_product_itemst*)this,unit,in_items,in_reag,out_items,&call_native);
         if(!call_native)
             return;
 
@@ -308,7 +355,7 @@ struct product_hook : item_product {
         if ( out_items->size() == out_item_count )
             return;
         //if it produced something, call the scripts
-        onReactionComplete(out,this_reaction,(df::reaction_product_itemst*)this,unit,in_items,in_reag,out_items);
+        onReactionComplete_event(out,this_reaction,(df::reaction_product_itemst*)this,unit,in_items,in_reag,out_items);
     }
 };
 
@@ -320,9 +367,12 @@ struct item_hooks :df::item_actual {
 
         DEFINE_VMETHOD_INTERPOSE(void, contaminateWound,(df::unit* unit, df::unit_wound* wound, uint8_t a1, int16_t a2))
         {
-            CoreSuspendClaimer suspend;
-            color_ostream_proxy out(Core::getInstance().getConsole());
-            onItemContaminateWound(out,this,unit,wound,a1,a2);
+            if (onItemContaminateWound_event.has_listeners())
+            {
+                CoreSuspendClaimer suspend;
+                color_ostream_proxy out(Core::getInstance().getConsole());
+                onItemContaminateWound_event(out,this,unit,wound,a1,a2);
+            }
             INTERPOSE_NEXT(contaminateWound)(unit,wound,a1,a2);
         }
 
@@ -333,16 +383,24 @@ struct proj_item_hook: df::proj_itemst{
     typedef df::proj_itemst interpose_base;
     DEFINE_VMETHOD_INTERPOSE(bool,checkImpact,(bool mode))
     {
-        CoreSuspendClaimer suspend;
-        color_ostream_proxy out(Core::getInstance().getConsole());
-        onProjItemCheckImpact(out,this,mode);
+        if (onProjItemCheckImpact_event.has_listeners())
+        {
+            CoreSuspendClaimer suspend;
+            color_ostream_proxy out(Core::getInstance().getConsole());
+            onProjItemCheckImpact_event(out,this,mode);
+        }
         return INTERPOSE_NEXT(checkImpact)(mode); //returns destroy item or not?
     }
     DEFINE_VMETHOD_INTERPOSE(bool,checkMovement,())
     {
-        CoreSuspendClaimer suspend;
-        color_ostream_proxy out(Core::getInstance().getConsole());
-        onProjItemCheckMovement(out,this);
+        if (onProjItemCheckMovement_event.has_listeners())
+        {
+            CoreSuspendClaimer suspend;
+            color_ostream_proxy out(Core::getInstance().getConsole());
+            onProjItemCheckMovement_event(out,this);
+        }
+        if (onProjItemCheckMovementBatch_event.has_listeners())
+            moved_proj_items.push_back(id);
         return INTERPOSE_NEXT(checkMovement)();
     }
 };
@@ -353,16 +411,24 @@ struct proj_unit_hook: df::proj_unitst{
     typedef df::proj_unitst interpose_base;
     DEFINE_VMETHOD_INTERPOSE(bool,checkImpact,(bool mode))
     {
-        CoreSuspendClaimer suspend;
-        color_ostream_proxy out(Core::getInstance().getConsole());
-        onProjUnitCheckImpact(out,this,mode);
+        if (onProjUnitCheckImpact_event.has_listeners())
+        {
+            CoreSuspendClaimer suspend;
+            color_ostream_proxy out(Core::getInstance().getConsole());
+            onProjUnitCheckImpact_event(out,this,mode);
+        }
         return INTERPOSE_NEXT(checkImpact)(mode); //returns destroy item or not?
     }
     DEFINE_VMETHOD_INTERPOSE(bool,checkMovement,())
     {
-        CoreSuspendClaimer suspend;
-        color_ostream_proxy out(Core::getInstance().getConsole());
-        onProjUnitCheckMovement(out,this);
+        if (onProjUnitCheckMovement_event.has_listeners())
+        {
+            CoreSuspendClaimer suspend;
+            color_ostream_proxy out(Core::getInstance().getConsole());
+            onProjUnitCheckMovement_event(out,this);
+        }
+        if (onProjUnitCheckMovementBatch_event.has_listeners())
+            moved_proj_units.push_back(id);
         return INTERPOSE_NEXT(checkMovement)();
     }
 };
@@ -417,28 +483,95 @@ static bool find_reactions(color_ostream &out)
     return !products.empty();
 }
 
+static bool set_hook(VMethodInterposeLinkBase &hook, bool enable, bool allow_remove)
+{
+    if (enable || allow_remove)
+        hook.apply(enable);
+    else if (hook.is_applied())
+        hooks_dirty = true;
+    return hook.is_applied();
+}
+static void update_hooks(bool allow_remove)
+{
+    if (allow_remove)
+        hooks_dirty = false;
+    bool sidebar = hooks_enabled && (onWorkshopFillSidebarMenu_event.has_listeners() ||
+                                     postWorkshopFillSidebarMenu_event.has_listeners());
+    bool applied = false;
+    applied |= set_hook(INTERPOSE_HOOK(workshop_hook,fillSidebarMenu), sidebar, allow_remove);
+    applied |= set_hook(INTERPOSE_HOOK(furnace_hook,fillSidebarMenu), sidebar, allow_remove);
+    // products is only filled while a world with matching reactions is loaded
+    applied |= set_hook(INTERPOSE_HOOK(product_hook, produce),
+             hooks_enabled && !products.empty() &&
+             (onReactionCompleting_event.has_listeners() || onReactionComplete_event.has_listeners()),
+             allow_remove);
+    applied |= set_hook(INTERPOSE_HOOK(item_hooks,contaminateWound),
+             hooks_enabled && onItemContaminateWound_event.has_listeners(), allow_remove);
+    applied |= set_hook(INTERPOSE_HOOK(proj_unit_hook,checkImpact),
+             hooks_enabled && onProjUnitCheckImpact_event.has_listeners(), allow_remove);
+    applied |= set_hook(INTERPOSE_HOOK(proj_unit_hook,checkMovement),
+             hooks_enabled && (onProjUnitCheckMovement_event.has_listeners() ||
+                               onProjUnitCheckMovementBatch_event.has_listeners()), allow_remove);
+    applied |= set_hook(INTERPOSE_HOOK(proj_item_hook,checkImpact),
+             hooks_enabled && onProjItemCheckImpact_event.has_listeners(), allow_remove);
+    applied |= set_hook(INTERPOSE_HOOK(proj_item_hook,checkMovement),
+             hooks_enabled && (onProjItemCheckMovement_event.has_listeners() ||
+                               onProjItemCheckMovementBatch_event.has_listeners()), allow_remove);
+    is_enabled = applied;
+}
 static void enable_hooks(bool enable)
 {
-    INTERPOSE_HOOK(workshop_hook,fillSidebarMenu).apply(enable);
-    INTERPOSE_HOOK(furnace_hook,fillSidebarMenu).apply(enable);
-    INTERPOSE_HOOK(item_hooks,contaminateWound).apply(enable);
-    INTERPOSE_HOOK(proj_unit_hook,checkImpact).apply(enable);
-    INTERPOSE_HOOK(proj_unit_hook,checkMovement).apply(enable);
-    INTERPOSE_HOOK(proj_item_hook,checkImpact).apply(enable);
-    INTERPOSE_HOOK(proj_item_hook,checkMovement).apply(enable);
+    hooks_enabled = enable;
+    update_hooks();
 }
 static void world_specific_hooks(color_ostream &out,bool enable)
 {
-    if(enable && find_reactions(out))
-    {
-        INTERPOSE_HOOK(product_hook, produce).apply(true);
-    }
-    else
+    if(!enable || !find_reactions(out))
     {
-        INTERPOSE_HOOK(product_hook, produce).apply(false);
         reactions.clear();
         products.clear();
     }
+    moved_proj_items.clear();
+    moved_proj_units.clear();
+    update_hooks();
+}
+/*
+ * Batched projectile events
+ */
+template<class T>
+static void push_moved_projectiles(color_ostream &out, hooked_event<> &event, std::vector<int32_t> &ids)
+{
+    if (ids.empty())
+        return;
+    std::sort(ids.begin(), ids.end());
+    auto state = event.state_if_count();
+    if (!state)
+    {
+        ids.clear();
+        return;
+    }
+    // projectiles that hit something since they moved are already gone
+    lua_newtable(state);
+    int count = 0;
+    for (auto link = world->proj_list.next; link; link = link->next)
+    {
+        auto proj = strict_virtual_cast<T>(link->item);
+        if (proj && std::binary_search(ids.begin(), ids.end(), proj->id))
+        {
+            Lua::PushDFObject(state, proj);
+            lua_rawseti(state, -2, ++count);
+        }
+    }
+    ids.clear();
+    event.invoke(out, 1);
+}
+DFhackCExport command_result plugin_onupdate ( color_ostream &out )
+{
+    if (hooks_dirty)
+        update_hooks();
+    push_moved_projectiles<df::proj_itemst>(out, onProjItemCheckMovementBatch_event, moved_proj_items);
+    push_moved_projectiles<df::proj_unitst>(out, onProjUnitCheckMovementBatch_event, moved_proj_units);
+    return CR_OK;
 }
 void disable_all_hooks(color_ostream &out)
 {
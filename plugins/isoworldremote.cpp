@@ -19,9 +19,13 @@
 #include "modules/Materials.h"
 
 //Needed for writing the protobuff stuff to a file.
+#include <algorithm>
 #include <fstream>
 #include <string>
 #include <iomanip>
+#include <vector>
+
+#include "tinythread.h"
 
 #include "isoworldremote.pb.h"
 
@@ -42,11 +46,13 @@ REQUIRE_GLOBAL(cur_season);
 command_result isoWorldRemote (color_ostream &out, std::vector <std::string> & parameters);
 
 static command_result GetEmbarkTile(color_ostream &stream, const TileRequest *in, EmbarkTile *out);
+static command_result GetEmbarkTiles(color_ostream &stream, const TileListRequest *in, EmbarkTileList *out);
 static command_result GetEmbarkInfo(color_ostream &stream, const MapRequest *in, MapReply *out);
 static command_result GetRawNames(color_ostream &stream, const MapRequest *in, RawNames *out);
 
 bool gather_embark_tile_layer(int EmbX, int EmbY, int EmbZ, EmbarkTileLayer * tile, MapExtras::MapCache * MP);
 bool gather_embark_tile(int EmbX, int EmbY, EmbarkTile * tile, MapExtras::MapCache * MP);
+void gather_embark_tiles(const std::vector<df::coord2d> & coords, const std::vector<EmbarkTile *> & tiles, MapExtras::MapCache * MP);
 
 // Mandatory init function. If you have some global state, create it here.
 DFhackCExport command_result plugin_init ( color_ostream &out, std::vector <PluginCommand> &commands)
@@ -68,6 +74,7 @@ DFhackCExport RPCService *plugin_rpcconnect(color_ostream &)
 {
     RPCService *svc = new RPCService();
     svc->addFunction("GetEmbarkTile", GetEmbarkTile);
+    svc->addFunction("GetEmbarkTiles", GetEmbarkTiles);
     svc->addFunction("GetEmbarkInfo", GetEmbarkInfo);
     svc->addFunction("GetRawNames", GetRawNames);
     return svc;
@@ -175,6 +182,37 @@ static command_result GetEmbarkTile(color_ostream &stream, const TileRequest *in
     return CR_OK;
 }
 
+// Gathers all the requested tiles from one map cache. Tiles whose content
+// hash matches the one the client already has are sent without layers.
+static command_result GetEmbarkTiles(color_ostream &stream, const TileListRequest *in, EmbarkTileList *out)
+{
+    int count = std::min(in->want_x_size(), in->want_y_size());
+    std::vector<df::coord2d> coords;
+    std::vector<EmbarkTile *> tiles;
+    coords.reserve(count);
+    tiles.reserve(count);
+    for (int i = 0; i < count; i++)
+    {
+        coords.push_back(df::coord2d(in->want_x(i) * 3, in->want_y(i) * 3));
+        tiles.push_back(out->add_tile());
+    }
+
+    MapExtras::MapCache MC;
+    gather_embark_tiles(coords, tiles, &MC);
+    MC.trash();
+
+    for (int i = 0; i < count && i < in->known_hash_size(); i++)
+    {
+        EmbarkTile *tile = tiles[i];
+        if (in->known_hash(i) != 0 && in->known_hash(i) == tile->content_hash())
+        {
+            tile->clear_tile_layer();
+            tile->set_unchanged(true);
+        }
+    }
+    return CR_OK;
+}
+
 static command_result GetEmbarkInfo(color_ostream &stream, const MapRequest *in, MapReply *out)
 {
     if(!Core::getInstance().isWorldLoaded()) {
@@ -217,24 +255,129 @@ int coord_to_index_48(int x, int y) {
     return y*48+x;
 }
 
-bool gather_embark_tile(int EmbX, int EmbY, EmbarkTile * tile, MapExtras::MapCache * MP) {
-    tile->set_is_valid(false);
-    tile->set_world_x(world->map.region_x + (EmbX/3));
-    tile->set_world_y(world->map.region_y + (EmbY/3));
-    tile->set_world_z(world->map.region_z + 1); //adding one because floors get shifted one downwards.
-    tile->set_current_year(*cur_year);
-    tile->set_current_season(*cur_season);
-    int num_valid_layers = 0;
+static const uint64_t fnv_offset = 14695981039346656037ULL;
+static const uint64_t fnv_prime = 1099511628211ULL;
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= fnv_prime;
+    }
+    return hash;
+}
+
+// One z-level of one embark tile. Jobs only read from the map cache once
+// preload_embark_tile has been called, so they can run on several threads.
+struct layer_job
+{
+    int EmbX, EmbY, EmbZ;
+    EmbarkTileLayer *layer;
+    bool valid;
+    uint64_t hash;
+};
+
+struct layer_worker
+{
+    std::vector<layer_job> *jobs;
+    MapExtras::MapCache *MP;
+    size_t first, step;
+};
+
+static void gather_layer_jobs(void *arg)
+{
+    layer_worker *worker = (layer_worker *)arg;
+    std::vector<layer_job> &jobs = *worker->jobs;
+    for (size_t i = worker->first; i < jobs.size(); i += worker->step)
+    {
+        layer_job &job = jobs[i];
+        job.valid = gather_embark_tile_layer(job.EmbX, job.EmbY, job.EmbZ, job.layer, worker->MP);
+        job.hash = hash_bytes(fnv_offset, job.layer->mat_type_table().data(),
+                              job.layer->mat_type_table_size() * sizeof(int));
+        job.hash = hash_bytes(job.hash, job.layer->mat_subtype_table().data(),
+                              job.layer->mat_subtype_table_size() * sizeof(int32_t));
+    }
+}
+
+// Loads every block of the embark tile, including the material info that
+// the blocks would otherwise parse on first use.
+static void preload_embark_tile(int EmbX, int EmbY, MapExtras::MapCache * MP)
+{
     for(uint32_t z = 0; z < MP->maxZ(); z++)
     {
-        EmbarkTileLayer * tile_layer = tile->add_tile_layer();
-        num_valid_layers += gather_embark_tile_layer(EmbX, EmbY, z, tile_layer, MP);
+        for(int yy = 0; yy < 3; yy++) {
+            for(int xx = 0; xx < 3; xx++) {
+                MapExtras::Block * b = MP->BlockAt(DFCoord(EmbX+xx, EmbY+yy, z));
+                if(b && b->getRaw())
+                    b->staticMaterialAt(df::coord2d(0, 0));
+            }
+        }
     }
-    if(num_valid_layers > 0)
-        tile->set_is_valid(true);
-    return 1;
 }
 
+void gather_embark_tiles(const std::vector<df::coord2d> & coords, const std::vector<EmbarkTile *> & tiles, MapExtras::MapCache * MP) {
+    std::vector<layer_job> jobs;
+    jobs.reserve(tiles.size() * MP->maxZ());
+    for(size_t i = 0; i < tiles.size(); i++)
+    {
+        int EmbX = coords[i].x;
+        int EmbY = coords[i].y;
+        EmbarkTile * tile = tiles[i];
+        tile->set_is_valid(false);
+        tile->set_world_x(world->map.region_x + (EmbX/3));
+        tile->set_world_y(world->map.region_y + (EmbY/3));
+        tile->set_world_z(world->map.region_z + 1); //adding one because floors get shifted one downwards.
+        tile->set_current_year(*cur_year);
+        tile->set_current_season(*cur_season);
+        preload_embark_tile(EmbX, EmbY, MP);
+        for(uint32_t z = 0; z < MP->maxZ(); z++)
+        {
+            layer_job job = { EmbX, EmbY, int(z), tile->add_tile_layer(), false, 0 };
+            jobs.push_back(job);
+        }
+    }
+
+    size_t num_threads = tthread::thread::hardware_concurrency();
+    num_threads = std::max<size_t>(1, std::min(num_threads, jobs.size()));
+    std::vector<layer_worker> workers(num_threads);
+    std::vector<tthread::thread *> threads;
+    for(size_t i = 0; i < num_threads; i++)
+    {
+        layer_worker worker = { &jobs, MP, i, num_threads };
+        workers[i] = worker;
+        if(i > 0)
+            threads.push_back(new tthread::thread(gather_layer_jobs, &workers[i]));
+    }
+    gather_layer_jobs(&workers[0]);
+    for(size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i]->join();
+        delete threads[i];
+    }
+
+    size_t job = 0;
+    for(size_t i = 0; i < tiles.size(); i++)
+    {
+        uint64_t hash = fnv_offset;
+        bool valid = false;
+        for(uint32_t z = 0; z < MP->maxZ(); z++, job++)
+        {
+            valid = valid || jobs[job].valid;
+            hash = hash_bytes(hash, &jobs[job].hash, sizeof(jobs[job].hash));
+        }
+        tiles[i]->set_is_valid(valid);
+        tiles[i]->set_content_hash(hash);
+    }
+}
+
+bool gather_embark_tile(int EmbX, int EmbY, EmbarkTile * tile, MapExtras::MapCache * MP) {
+    std::vector<df::coord2d> coords(1, df::coord2d(EmbX, EmbY));
+    std::vector<EmbarkTile *> tiles(1, tile);
+    gather_embark_tiles(coords, tiles, MP);
+    return 1;
+}
 
 bool gather_embark_tile_layer(int EmbX, int EmbY, int EmbZ, EmbarkTileLayer * tile, MapExtras::MapCache * MP)
 {
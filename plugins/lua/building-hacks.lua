@@ -28,15 +28,17 @@ local _ENV = mkmodule('plugins.building-hacks')
 _registeredStuff={}
 local function unregall(state)
     if state==SC_WORLD_UNLOADED then
-        onUpdateAction._library=nil
+        onUpdateActionBatch._library=nil
         dfhack.onStateChange.building_hacks= nil
         _registeredStuff={}
     end
 end
-local function onUpdateLocal(workshop)
-    local f=_registeredStuff[workshop:getCustomType()]
+local function onUpdateLocal(shop_type,workshops)
+    local f=_registeredStuff[shop_type]
     if f then
-        f(workshop)
+        for _,workshop in ipairs(workshops) do
+            f(workshop)
+        end
     end
 end
 local function findCustomWorkshop(name)
@@ -49,7 +51,7 @@ local function findCustomWorkshop(name)
 end
 local function registerUpdateAction(shopId,callback)
     _registeredStuff[shopId]=callback
-    onUpdateAction._library=onUpdateLocal
+    onUpdateActionBatch._library=onUpdateLocal
     dfhack.onStateChange.building_hacks=unregall
 end
 local function generateFrame(tiles,w,h)
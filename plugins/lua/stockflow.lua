@@ -1076,16 +1076,22 @@ function orders_match(a, b)
     return true
 end
 
+-- The fields compared by orders_match.
+local order_fields = {
+    "job_type",
+    "item_subtype",
+    "reaction_name",
+    "mat_type",
+    "mat_index",
+    "item_category",
+    "material_category",
+}
+
 -- Reduce the quantity by the number of matching orders in the queue.
 function order_quantity(order, quantity)
-    local amount = quantity
-    for _, managed in ipairs(df.global.world.manager_orders) do
-        if orders_match(order, managed) then
-            amount = amount - managed.amount_left
-            if amount < 0 then
-                return 0
-            end
-        end
+    local amount = quantity - dfhack.job.getOrderAmountLeft(order, order_fields)
+    if amount < 0 then
+        return 0
     end
 
     return amount
@@ -9,6 +9,8 @@
 
 #include "json/json.h"
 
+#include <unordered_map>
+
 #include "df/building.h"
 #include "df/historical_figure.h"
 #include "df/itemdef_ammost.h"
@@ -29,6 +31,7 @@
 #include "df/manager_order.h"
 #include "df/manager_order_condition_item.h"
 #include "df/manager_order_condition_order.h"
+#include "df/reaction.h"
 #include "df/world.h"
 
 using namespace DFHack;
@@ -138,6 +141,27 @@ static void bitfield_to_json_array(Json::Value & out, B bits)
     }
 }
 
+// Bit names are looked up once per bitfield type instead of scanning the
+// bitfield's items for every name.
+template<typename B>
+static const std::unordered_map<std::string, unsigned> & bitfield_index()
+{
+    static std::unordered_map<std::string, unsigned> index;
+    if (index.empty())
+    {
+        typedef df::bitfield_traits<B> traits;
+        for (unsigned i = 0; i < traits::bit_count; i++)
+        {
+            // findBitfieldField returns the first match, so keep that one
+            if (traits::bits[i].name)
+            {
+                index.insert(std::make_pair(std::string(traits::bits[i].name), i));
+            }
+        }
+    }
+    return index;
+}
+
 template<typename B>
 static void json_array_to_bitfield(B & bits, Json::Value & arr)
 {
@@ -146,6 +170,9 @@ static void json_array_to_bitfield(B & bits, Json::Value & arr)
         return;
     }
 
+    typedef df::bitfield_traits<B> traits;
+    auto & index = bitfield_index<B>();
+
     for (Json::ArrayIndex i = arr.size(); i != 0; i--)
     {
         if (!arr[i - 1].isString())
@@ -153,16 +180,18 @@ static void json_array_to_bitfield(B & bits, Json::Value & arr)
             continue;
         }
 
-        std::string str(arr[i - 1].asString());
+        auto found = index.find(arr[i - 1].asString());
+        if (found == index.end())
+        {
+            continue;
+        }
 
-        int current;
-        if (get_bitfield_field(&current, bits, str))
+        unsigned idx = found->second;
+        if (!getBitfieldField(&bits.whole, idx, traits::bits[idx].size))
         {
-            if (!current && set_bitfield_field(&bits, str, 1))
-            {
-                Json::Value removed;
-                arr.removeIndex(i - 1, &removed);
-            }
+            setBitfieldField(&bits.whole, idx, traits::bits[idx].size, 1);
+            Json::Value removed;
+            arr.removeIndex(i - 1, &removed);
         }
     }
 }
@@ -173,17 +202,29 @@ static df::itemdef *get_itemdef(int16_t subtype)
     return D::find(subtype);
 }
 
+typedef std::unordered_map<std::string, df::itemdef *> itemdef_index;
+
+// An itemdef id to look up, along with the index for its item type,
+// which is filled in on first use.
+struct itemdef_key
+{
+    const std::string & id;
+    itemdef_index & index;
+};
+
 template<typename D>
-static df::itemdef *get_itemdef(const std::string & subtype)
+static df::itemdef *get_itemdef(const itemdef_key & key)
 {
-    for (auto it : D::get_vector())
+    if (key.index.empty())
     {
-        if (it->id == subtype)
+        for (auto it : D::get_vector())
         {
-            return it;
+            key.index.insert(std::make_pair(it->id, it));
         }
     }
-    return nullptr;
+
+    auto found = key.index.find(key.id);
+    return found == key.index.end() ? nullptr : found->second;
 }
 
 template<typename ST>
@@ -225,6 +266,67 @@ static df::itemdef *get_itemdef(color_ostream & out, df::item_type type, ST subt
     }
 }
 
+// Name lookups shared by all the orders in one import.
+struct import_tables
+{
+    std::map<df::item_type, itemdef_index> itemdefs;
+    std::unordered_map<std::string, MaterialInfo> materials;
+    std::unordered_map<std::string, int32_t> inorganics;
+    std::unordered_map<std::string, int32_t> reactions;
+
+    df::itemdef *find_itemdef(color_ostream & out, df::item_type type, const std::string & id)
+    {
+        itemdef_key key = { id, itemdefs[type] };
+        return get_itemdef(out, type, key);
+    }
+
+    bool find_material(MaterialInfo *mat, const std::string & token)
+    {
+        auto found = materials.find(token);
+        if (found == materials.end())
+        {
+            MaterialInfo info;
+            if (!info.find(token))
+            {
+                info.decode(-1);
+            }
+            found = materials.insert(std::make_pair(token, info)).first;
+        }
+        *mat = found->second;
+        return mat->isValid();
+    }
+
+    int32_t find_inorganic(const std::string & id)
+    {
+        if (inorganics.empty())
+        {
+            auto & raws = world->raws.inorganics;
+            for (size_t i = 0; i < raws.size(); i++)
+            {
+                inorganics.insert(std::make_pair(raws[i]->id, int32_t(i)));
+            }
+        }
+
+        auto found = inorganics.find(id);
+        return found == inorganics.end() ? -1 : found->second;
+    }
+
+    int32_t find_reaction(const std::string & code)
+    {
+        if (reactions.empty())
+        {
+            auto & raws = world->raws.reactions.reactions;
+            for (size_t i = 0; i < raws.size(); i++)
+            {
+                reactions.insert(std::make_pair(raws[i]->code, int32_t(i)));
+            }
+        }
+
+        auto found = reactions.find(code);
+        return found == reactions.end() ? -1 : found->second;
+    }
+};
+
 static command_result orders_export_command(color_ostream & out, const std::string & name)
 {
     if (!is_safe_filename(out, name))
@@ -410,6 +512,9 @@ static command_result orders_export_command(color_ostream & out, const std::stri
         }
     }
 
+    // The document is built while DF is suspended and only written out after
+    // resuming, so the game does not wait on the disk. Streaming the orders to
+    // the file as they are converted would hold the suspend for the whole write.
     Filesystem::mkdir("dfhack-config/orders");
 
     std::ofstream file("dfhack-config/orders/" + name + ".json");
@@ -419,56 +524,9 @@ static command_result orders_export_command(color_ostream & out, const std::stri
     return file.good() ? CR_OK : CR_FAILURE;
 }
 
-static command_result orders_import_command(color_ostream & out, const std::string & name)
+static command_result import_orders(color_ostream & out, Json::Value & orders, const std::map<int32_t, int32_t> & id_mapping, std::vector<df::manager_order *> & imported)
 {
-    if (!is_safe_filename(out, name))
-    {
-        return CR_WRONG_USAGE;
-    }
-
-    const std::string filename("dfhack-config/orders/" + name + ".json");
-    Json::Value orders;
-
-    {
-        std::ifstream file(filename);
-
-        if (!file.good())
-        {
-            out << COLOR_LIGHTRED << "Cannot find orders file: " << filename << std::endl;
-            return CR_FAILURE;
-        }
-
-        try
-        {
-            file >> orders;
-        }
-        catch (const std::exception & e)
-        {
-            out << COLOR_LIGHTRED << "Error reading orders file: " << filename << ": " << e.what() << std::endl;
-            return CR_FAILURE;
-        }
-
-        if (!file.good())
-        {
-            out << COLOR_LIGHTRED << "Error reading orders file: " << filename << std::endl;
-            return CR_FAILURE;
-        }
-    }
-
-    if (orders.type() != Json::arrayValue)
-    {
-        out << COLOR_LIGHTRED << "Invalid orders file: " << filename << ": expected array" << std::endl;
-        return CR_FAILURE;
-    }
-
-    CoreSuspender suspend;
-
-    std::map<int32_t, int32_t> id_mapping;
-    for (auto it : orders)
-    {
-        id_mapping[it["id"].asInt()] = world->manager_order_next_id;
-        world->manager_order_next_id++;
-    }
+    import_tables tables;
 
     for (auto & it : orders)
     {
@@ -487,6 +545,11 @@ static command_result orders_import_command(color_ostream & out, const std::stri
 
         if (it.isMember("reaction"))
         {
+            if (tables.find_reaction(it["reaction"].asString()) < 0)
+            {
+                out << COLOR_YELLOW << "Unknown reaction for imported manager order: " << it["reaction"].asString() << std::endl;
+            }
+
             order->reaction_name = it["reaction"].asString();
         }
 
@@ -503,7 +566,7 @@ static command_result orders_import_command(color_ostream & out, const std::stri
         }
         if (it.isMember("item_subtype"))
         {
-            df::itemdef *def = get_itemdef(out, order->item_type == item_type::NONE ? ENUM_ATTR(job_type, item, order->job_type) : order->item_type, it["item_subtype"].asString());
+            df::itemdef *def = tables.find_itemdef(out, order->item_type == item_type::NONE ? ENUM_ATTR(job_type, item, order->job_type) : order->item_type, it["item_subtype"].asString());
 
             if (def)
             {
@@ -527,7 +590,7 @@ static command_result orders_import_command(color_ostream & out, const std::stri
         else if (it.isMember("material"))
         {
             MaterialInfo mat;
-            if (!mat.find(it["material"].asString()))
+            if (!tables.find_material(&mat, it["material"].asString()))
             {
                 delete order;
 
@@ -679,7 +742,7 @@ static command_result orders_import_command(color_ostream & out, const std::stri
                 }
                 if (it2.isMember("item_subtype"))
                 {
-                    df::itemdef *def = get_itemdef(out, condition->item_type, it2["item_subtype"].asString());
+                    df::itemdef *def = tables.find_itemdef(out, condition->item_type, it2["item_subtype"].asString());
 
                     if (def)
                     {
@@ -698,7 +761,7 @@ static command_result orders_import_command(color_ostream & out, const std::stri
                 if (it2.isMember("material"))
                 {
                     MaterialInfo mat;
-                    if (!mat.find(it2["material"].asString()))
+                    if (!tables.find_material(&mat, it2["material"].asString()))
                     {
                         delete condition;
 
@@ -712,9 +775,8 @@ static command_result orders_import_command(color_ostream & out, const std::stri
 
                 if (it2.isMember("bearing"))
                 {
-                    std::string bearing(it2["bearing"].asString());
-                    auto found = std::find_if(world->raws.inorganics.begin(), world->raws.inorganics.end(), [bearing](df::inorganic_raw *raw) -> bool { return raw->id == bearing; });
-                    if (found == world->raws.inorganics.end())
+                    int32_t bearing = tables.find_inorganic(it2["bearing"].asString());
+                    if (bearing < 0)
                     {
                         delete condition;
 
@@ -722,7 +784,7 @@ static command_result orders_import_command(color_ostream & out, const std::stri
 
                         continue;
                     }
-                    condition->inorganic_bearing = found - world->raws.inorganics.begin();
+                    condition->inorganic_bearing = bearing;
                 }
 
                 if (it2.isMember("reaction_class"))
@@ -787,12 +849,76 @@ static command_result orders_import_command(color_ostream & out, const std::stri
 
         // TODO: anon_1
 
-        world->manager_orders.push_back(order);
+        imported.push_back(order);
     }
 
     return CR_OK;
 }
 
+static command_result orders_import_command(color_ostream & out, const std::string & name)
+{
+    if (!is_safe_filename(out, name))
+    {
+        return CR_WRONG_USAGE;
+    }
+
+    const std::string filename("dfhack-config/orders/" + name + ".json");
+    Json::Value orders;
+
+    {
+        std::ifstream file(filename);
+
+        if (!file.good())
+        {
+            out << COLOR_LIGHTRED << "Cannot find orders file: " << filename << std::endl;
+            return CR_FAILURE;
+        }
+
+        try
+        {
+            file >> orders;
+        }
+        catch (const std::exception & e)
+        {
+            out << COLOR_LIGHTRED << "Error reading orders file: " << filename << ": " << e.what() << std::endl;
+            return CR_FAILURE;
+        }
+
+        if (!file.good())
+        {
+            out << COLOR_LIGHTRED << "Error reading orders file: " << filename << std::endl;
+            return CR_FAILURE;
+        }
+    }
+
+    if (orders.type() != Json::arrayValue)
+    {
+        out << COLOR_LIGHTRED << "Invalid orders file: " << filename << ": expected array" << std::endl;
+        return CR_FAILURE;
+    }
+
+    CoreSuspender suspend;
+
+    // Reserve ids for the whole file at once.
+    std::map<int32_t, int32_t> id_mapping;
+    int32_t next_id = world->manager_order_next_id;
+    for (auto & it : orders)
+    {
+        id_mapping[it["id"].asInt()] = next_id++;
+    }
+    world->manager_order_next_id = next_id;
+
+    std::vector<df::manager_order *> imported;
+    imported.reserve(orders.size());
+
+    command_result result = import_orders(out, orders, id_mapping, imported);
+
+    // As before, orders read before an error are kept.
+    world->manager_orders.insert(world->manager_orders.end(), imported.begin(), imported.end());
+
+    return result;
+}
+
 static command_result orders_clear_command(color_ostream & out)
 {
     CoreSuspender suspend;
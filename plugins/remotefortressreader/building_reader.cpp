@@ -63,6 +63,8 @@
 
 #include "modules/Buildings.h"
 
+#include <algorithm>
+#include <time.h>
 
 using namespace DFHack;
 using namespace df::enums;
@@ -288,7 +290,11 @@ DFHack::command_result GetBuildingDefList(DFHack::color_ostream &stream, const D
 
 void CopyBuilding(int buildingIndex, RemoteFortressReader::BuildingInstance * remote_build)
 {
-    df::building * local_build = df::global::world->buildings.all[buildingIndex];
+    CopyBuilding(df::global::world->buildings.all[buildingIndex], remote_build);
+}
+
+void CopyBuilding(df::building * local_build, RemoteFortressReader::BuildingInstance * remote_build)
+{
     remote_build->set_index(local_build->id);
     int minZ = local_build->z;
     if (local_build->getType() == df::enums::building_type::Well)
@@ -915,3 +921,128 @@ void CopyBuilding(int buildingIndex, RemoteFortressReader::BuildingInstance * re
     }
 }
 
+// Buildings bucketed by the map block they overlap, kept between requests.
+// The whole index is rebuilt when a building goes away, and patched when new
+// buildings are appended to the end of buildings.all.
+static struct
+{
+    df::map_block **** block_index = NULL;
+    int x_count = 0;
+    int y_count = 0;
+    int z_count = 0;
+    size_t known_count = 0;
+    df::building * known_last = NULL;
+    int32_t known_last_id = -1;
+    int32_t known_next_id = -1;
+    int32_t stamp = 0;
+    std::vector<std::vector<df::building *> > blocks;
+    std::vector<df::building *> wells;
+} building_buckets;
+
+static void AddBuildingToBuckets(df::building * bld)
+{
+    auto & bb = building_buckets;
+    if (bld->getType() == df::enums::building_type::Well)
+    {
+        bb.wells.push_back(bld);
+        return;
+    }
+    if (bld->z < 0 || bld->z >= bb.z_count)
+        return;
+    int bx1 = std::max(bld->x1 >> 4, 0);
+    int by1 = std::max(bld->y1 >> 4, 0);
+    int bx2 = std::min(bld->x2 >> 4, bb.x_count - 1);
+    int by2 = std::min(bld->y2 >> 4, bb.y_count - 1);
+    for (int bx = bx1; bx <= bx2; bx++)
+        for (int by = by1; by <= by2; by++)
+            bb.blocks[(bx * bb.y_count + by) * bb.z_count + bld->z].push_back(bld);
+}
+
+static void RefreshBuildingBuckets()
+{
+    auto & bb = building_buckets;
+    auto & map = df::global::world->map;
+    auto & all = df::global::world->buildings.all;
+    int32_t next_id = df::global::building_next_id ? *df::global::building_next_id : -1;
+
+    bool same_map = bb.block_index == map.block_index
+        && bb.x_count == map.x_count_block
+        && bb.y_count == map.y_count_block
+        && bb.z_count == map.z_count_block;
+    df::building * last = all.empty() ? NULL : all.back();
+    if (same_map && all.size() == bb.known_count && last == bb.known_last && next_id == bb.known_next_id)
+        return;
+
+    size_t start = 0;
+    // A new building can be allocated where a removed one was, so the id is
+    // checked too. Ids are never reused and buildings.all is sorted by id, so
+    // the id only stays at that index if nothing before it was removed.
+    if (same_map && bb.known_count > 0 && all.size() > bb.known_count
+        && all[bb.known_count - 1] == bb.known_last && all[bb.known_count - 1]->id == bb.known_last_id)
+    {
+        // Nothing was removed, so only the new tail needs to be bucketed.
+        start = bb.known_count;
+    }
+    else
+    {
+        bb.block_index = map.block_index;
+        bb.x_count = map.x_count_block;
+        bb.y_count = map.y_count_block;
+        bb.z_count = map.z_count_block;
+        bb.blocks.clear();
+        if (bb.block_index)
+            bb.blocks.resize(size_t(bb.x_count) * bb.y_count * bb.z_count);
+        bb.wells.clear();
+    }
+
+    if (bb.block_index)
+    {
+        for (size_t i = start; i < all.size(); i++)
+            AddBuildingToBuckets(all[i]);
+    }
+
+    bb.known_count = all.size();
+    bb.known_last = last;
+    bb.known_last_id = last ? last->id : -1;
+    bb.known_next_id = next_id;
+    if (bb.stamp == 0)
+        bb.stamp = int32_t(time(NULL) & 0x7FFFFFFF);
+    else
+        bb.stamp++;
+}
+
+static bool CompareBuildingId(df::building * a, df::building * b)
+{
+    return a->id < b->id;
+}
+
+void GetBuildingsInBlocks(DFCoord min, DFCoord max, std::vector<df::building *> & out)
+{
+    RefreshBuildingBuckets();
+    auto & bb = building_buckets;
+    out.clear();
+    if (!bb.block_index)
+        return;
+
+    int x1 = std::max<int>(min.x, 0), x2 = std::min<int>(max.x, bb.x_count);
+    int y1 = std::max<int>(min.y, 0), y2 = std::min<int>(max.y, bb.y_count);
+    int z1 = std::max<int>(min.z, 0), z2 = std::min<int>(max.z, bb.z_count);
+    for (int bx = x1; bx < x2; bx++)
+        for (int by = y1; by < y2; by++)
+            for (int bz = z1; bz < z2; bz++)
+            {
+                auto & bucket = bb.blocks[(bx * bb.y_count + by) * bb.z_count + bz];
+                out.insert(out.end(), bucket.begin(), bucket.end());
+            }
+    out.insert(out.end(), bb.wells.begin(), bb.wells.end());
+
+    // Buildings bigger than a block are in several buckets.
+    std::sort(out.begin(), out.end(), CompareBuildingId);
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+int32_t GetBuildingSetStamp()
+{
+    RefreshBuildingBuckets();
+    return building_buckets.stamp;
+}
@@ -1,10 +1,25 @@
 #ifndef BUILDING_READER_H
 #define BUILDING_READER_H
 #include <stdint.h>
+#include <vector>
 #include "RemoteClient.h"
 #include "RemoteFortressReader.pb.h"
+#include "modules/Maps.h"
+
+namespace df
+{
+    struct building;
+}
 
 DFHack::command_result GetBuildingDefList(DFHack::color_ostream &stream, const DFHack::EmptyMessage *in, RemoteFortressReader::BuildingList *out);
 void CopyBuilding(int buildingIndex, RemoteFortressReader::BuildingInstance * remote_build);
+void CopyBuilding(df::building * local_build, RemoteFortressReader::BuildingInstance * remote_build);
+
+// Collects the buildings whose footprint touches the blocks in [min, max), sorted by id.
+// Block coordinates are used for x and y, map z-levels for z. Wells are always included,
+// since their bucket moves and they can't be bucketed by position.
+void GetBuildingsInBlocks(DFCoord min, DFCoord max, std::vector<df::building *> & out);
+// Changes whenever a building is added to or removed from the world.
+int32_t GetBuildingSetStamp();
 
 #endif
\ No newline at end of file
@@ -1,3 +1,5 @@
+#include <unordered_map>
+
 #include "item_reader.h"
 #include "Core.h"
 #include "VersionInfo.h"
@@ -158,6 +160,45 @@ void CopyImage(const df::art_image * image, ArtImage * netImage)
     }
 }
 
+// The symbol lookup is a string map search, so it is only done once. Without
+// the symbol, loaded chunks are looked up by id through a map that is rebuilt
+// whenever the chunk list changes.
+static struct
+{
+    bool resolved = false;
+    GET_ART_IMAGE_CHUNK func = NULL;
+    df::world * known_world = NULL;
+    size_t known_count = 0;
+    df::art_image_chunk * known_last = NULL;
+    std::unordered_map<int, df::art_image_chunk *> by_id;
+} art_chunk_cache;
+
+df::art_image_chunk * FindArtImageChunk(int id)
+{
+    auto & cache = art_chunk_cache;
+    if (!cache.resolved)
+    {
+        cache.func = reinterpret_cast<GET_ART_IMAGE_CHUNK>(Core::getInstance().vinfo->getAddress("get_art_image_chunk"));
+        cache.resolved = true;
+    }
+    if (cache.func)
+        return cache.func(&(world->art_image_chunks), id);
+
+    auto & chunks = world->art_image_chunks;
+    df::art_image_chunk * last = chunks.empty() ? NULL : chunks.back();
+    if (cache.known_world != world || cache.known_count != chunks.size() || cache.known_last != last)
+    {
+        cache.by_id.clear();
+        for (size_t i = 0; i < chunks.size(); i++)
+            cache.by_id[chunks[i]->id] = chunks[i];
+        cache.known_world = world;
+        cache.known_count = chunks.size();
+        cache.known_last = last;
+    }
+    auto found = cache.by_id.find(id);
+    return found == cache.by_id.end() ? NULL : found->second;
+}
+
 void CopyItem(RemoteFortressReader::Item * NetItem, df::item * DfItem)
 {
     NetItem->set_id(DfItem->id);
@@ -234,20 +275,7 @@ void CopyItem(RemoteFortressReader::Item * NetItem, df::item * DfItem)
     {
         VIRTUAL_CAST_VAR(statue, df::item_statuest, DfItem);
 
-        df::art_image_chunk * chunk = NULL;
-        GET_ART_IMAGE_CHUNK GetArtImageChunk = reinterpret_cast<GET_ART_IMAGE_CHUNK>(Core::getInstance().vinfo->getAddress("get_art_image_chunk"));
-        if (GetArtImageChunk)
-        {
-            chunk = GetArtImageChunk(&(world->art_image_chunks), statue->image.id);
-        }
-        else
-        {
-            for (size_t i = 0; i < world->art_image_chunks.size(); i++)
-            {
-                if (world->art_image_chunks[i]->id == statue->image.id)
-                    chunk = world->art_image_chunks[i];
-            }
-        }
+        df::art_image_chunk * chunk = FindArtImageChunk(statue->image.id);
         if (chunk)
         {
             CopyImage(chunk->images[statue->image.subid], NetItem->mutable_image());
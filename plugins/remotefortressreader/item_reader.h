@@ -26,6 +26,7 @@ void CopyItem(RemoteFortressReader::Item * NetItem, df::item * DfItem);
 void ConvertDFColorDescriptor(int16_t index, RemoteFortressReader::ColorDefinition * out);
 
 typedef df::art_image_chunk * (*GET_ART_IMAGE_CHUNK)(std::vector<df::art_image_chunk* > *, int);
+df::art_image_chunk * FindArtImageChunk(int id);
 
 void CopyImage(const df::art_image * image, RemoteFortressReader::ArtImage * netImage);
 
@@ -1,8 +1,11 @@
 #include "df_version_int.h"
-#define RFR_VERSION "0.21.0"
+#define RFR_VERSION "0.22.0"
 
+#include <algorithm>
 #include <cstdio>
 #include <time.h>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "Console.h"
@@ -200,13 +203,10 @@ command_result loadArtImageChunk(color_ostream &out, vector <string> & parameter
         return CR_FAILURE;
     }
 
-    GET_ART_IMAGE_CHUNK GetArtImageChunk = reinterpret_cast<GET_ART_IMAGE_CHUNK>(Core::getInstance().vinfo->getAddress("get_art_image_chunk"));
-    if (GetArtImageChunk)
-    {
-        int index = atoi(parameters[0].c_str());
-        auto chunk = GetArtImageChunk(&(world->art_image_chunks), index);
+    int index = atoi(parameters[0].c_str());
+    auto chunk = FindArtImageChunk(index);
+    if (chunk)
         out.print("Loaded chunk id: %d\n", chunk->id);
-    }
     return CR_OK;
 }
 
@@ -776,6 +776,105 @@ void engravingIsNotNew(int index)
     engravingHashes[index] = false;
 }
 
+// Indices into world->engravings, bucketed by the map block they are in.
+// The buckets are kept with a copy of the vector they were made from, and
+// are patched when engravings were only appended to it, or rebuilt after
+// any other change.
+static struct
+{
+    df::map_block **** block_index = NULL;
+    int x_count = 0;
+    int y_count = 0;
+    int z_count = 0;
+    std::vector<df::engraving *> known;
+    std::vector<std::vector<int32_t> > blocks;
+} engraving_buckets;
+
+static void RefreshEngravingBuckets(bool force = false)
+{
+    auto & eb = engraving_buckets;
+    auto & map = world->map;
+    auto & all = world->engravings;
+
+    bool same_map = eb.block_index == map.block_index
+        && eb.x_count == map.x_count_block
+        && eb.y_count == map.y_count_block
+        && eb.z_count == map.z_count_block;
+    if (!force && same_map && all == eb.known)
+        return;
+
+    size_t start = 0;
+    if (!force && same_map && all.size() > eb.known.size()
+        && std::equal(eb.known.begin(), eb.known.end(), all.begin()))
+    {
+        // Nothing was removed, so only the new tail needs to be bucketed.
+        start = eb.known.size();
+    }
+    else
+    {
+        eb.block_index = map.block_index;
+        eb.x_count = map.x_count_block;
+        eb.y_count = map.y_count_block;
+        eb.z_count = map.z_count_block;
+        eb.blocks.clear();
+        if (eb.block_index)
+            eb.blocks.resize(size_t(eb.x_count) * eb.y_count * eb.z_count);
+    }
+
+    if (eb.block_index)
+    {
+        for (size_t i = start; i < all.size(); i++)
+        {
+            auto & pos = all[i]->pos;
+            int bx = pos.x >> 4, by = pos.y >> 4;
+            if (pos.x < 0 || pos.y < 0 || pos.z < 0 || bx >= eb.x_count || by >= eb.y_count || pos.z >= eb.z_count)
+                continue;
+            eb.blocks[(bx * eb.y_count + by) * eb.z_count + pos.z].push_back(int32_t(i));
+        }
+    }
+
+    eb.known = all;
+}
+
+// Collects indices of engravings in blocks min..max inclusive, in vector order.
+static void GetEngravingsInBlocks(DFCoord min, DFCoord max, std::vector<int32_t> & out)
+{
+    auto & eb = engraving_buckets;
+    auto & all = world->engravings;
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        RefreshEngravingBuckets(attempt > 0);
+        out.clear();
+        if (!eb.block_index)
+            return;
+
+        bool stale = false;
+        int x1 = std::max<int>(min.x, 0), x2 = std::min<int>(max.x, eb.x_count - 1);
+        int y1 = std::max<int>(min.y, 0), y2 = std::min<int>(max.y, eb.y_count - 1);
+        int z1 = std::max<int>(min.z, 0), z2 = std::min<int>(max.z, eb.z_count - 1);
+        for (int bx = x1; bx <= x2 && !stale; bx++)
+            for (int by = y1; by <= y2 && !stale; by++)
+                for (int bz = z1; bz <= z2 && !stale; bz++)
+                {
+                    for (int32_t idx : eb.blocks[(bx * eb.y_count + by) * eb.z_count + bz])
+                    {
+                        // An engraving freed and another made at the same address
+                        // leaves the vector unchanged, so check where it really is.
+                        auto & pos = all[idx]->pos;
+                        if ((pos.x >> 4) != bx || (pos.y >> 4) != by || pos.z != bz)
+                        {
+                            stale = true;
+                            break;
+                        }
+                        out.push_back(idx);
+                    }
+                }
+        if (!stale)
+            break;
+    }
+    std::sort(out.begin(), out.end());
+}
+
 static command_result ResetMapHashes(color_ostream &stream, const EmptyMessage *in)
 {
     hashes.clear();
@@ -1237,18 +1336,30 @@ void CopyProjectiles(RemoteFortressReader::MapBlock * NetBlock)
     }
 }
 
-void CopyBuildings(DFCoord min, DFCoord max, RemoteFortressReader::MapBlock * NetBlock, MapExtras::MapCache * MC)
+void CopyBuildings(DFCoord min, DFCoord max, RemoteFortressReader::MapBlock * NetBlock, MapExtras::MapCache * MC, bool listAll)
 {
+    std::vector<df::building *> nearby;
+    GetBuildingsInBlocks(DFCoord(min.x / 16, min.y / 16, min.z), DFCoord((max.x + 15) / 16, (max.y + 15) / 16, max.z), nearby);
 
-    for (size_t i = 0; i < df::global::world->buildings.all.size(); i++)
+    // Both lists are sorted by id, so the buildings outside the area are the gaps between the nearby ones.
+    auto & all = df::global::world->buildings.all;
+    size_t next_nearby = 0;
+    for (size_t i = 0; listAll && i < all.size(); i++)
     {
-        df::building * bld = df::global::world->buildings.all[i];
-        if (bld->x1 >= max.x || bld->y1 >= max.y || bld->x2 < min.x || bld->y2 < min.y)
+        if (next_nearby < nearby.size() && nearby[next_nearby] == all[i])
         {
-            auto out_bld = NetBlock->add_buildings();
-            out_bld->set_index(bld->id);
+            next_nearby++;
             continue;
         }
+        NetBlock->add_buildings()->set_index(all[i]->id);
+    }
+
+    for (size_t i = 0; i < nearby.size(); i++)
+    {
+        df::building * bld = nearby[i];
+        bool inside = true;
+        if (bld->x1 >= max.x || bld->y1 >= max.y || bld->x2 < min.x || bld->y2 < min.y)
+            inside = false;
 
         int z2 = bld->z;
 
@@ -1261,13 +1372,15 @@ void CopyBuildings(DFCoord min, DFCoord max, RemoteFortressReader::MapBlock * Ne
             }
         }
         if (bld->z < min.z || z2 >= max.z)
+            inside = false;
+        if (!inside)
         {
-            auto out_bld = NetBlock->add_buildings();
-            out_bld->set_index(bld->id);
+            if (listAll)
+                NetBlock->add_buildings()->set_index(bld->id);
             continue;
         }
         auto out_bld = NetBlock->add_buildings();
-        CopyBuilding(i, out_bld);
+        CopyBuilding(bld, out_bld);
         df::building_actual* actualBuilding = virtual_cast<df::building_actual>(bld);
         if (actualBuilding)
         {
@@ -1415,6 +1528,11 @@ static command_result GetBlockList(color_ostream &stream, const BlockRequest *in
     int min_z = in->min_z();
     int max_z = in->max_z();
     bool firstBlock = true; //Always send all the buildings needed on the first block, and none on the rest.
+    // Clients that still have the current building set only need the buildings in view.
+    int32_t buildingStamp = GetBuildingSetStamp();
+    bool buildingsUnchanged = in->has_building_set_stamp() && in->building_set_stamp() == buildingStamp;
+    out->set_building_set_stamp(buildingStamp);
+    out->set_buildings_unchanged(buildingsUnchanged);
                                 //stream.print("Got request for blocks from (%d, %d, %d) to (%d, %d, %d).\n", in->min_x(), in->min_y(), in->min_z(), in->max_x(), in->max_y(), in->max_z());
     for (int zz = max_z - 1; zz >= min_z; zz--)
     {
@@ -1477,7 +1595,7 @@ static command_result GetBlockList(color_ostream &stream, const BlockRequest *in
                             CopyDesignation(block, net_block, &MC, pos);
                         if (firstBlock)
                         {
-                            CopyBuildings(DFCoord(min_x * 16, min_y * 16, min_z), DFCoord(max_x * 16, max_y * 16, max_z), net_block, &MC);
+                            CopyBuildings(DFCoord(min_x * 16, min_y * 16, min_z), DFCoord(max_x * 16, max_y * 16, max_z), net_block, &MC, !buildingsUnchanged);
                             CopyProjectiles(net_block);
                             firstBlock = false;
                         }
@@ -1517,7 +1635,9 @@ static command_result GetBlockList(color_ostream &stream, const BlockRequest *in
         }
     }
 
-    for (size_t i = 0; i < world->engravings.size(); i++)
+    std::vector<int32_t> engravingIndices;
+    GetEngravingsInBlocks(DFCoord(min_x, min_y, min_z), DFCoord(max_x, max_y, max_z), engravingIndices);
+    for (int32_t i : engravingIndices)
     {
         auto engraving = world->engravings[i];
         if (engraving->pos.x < (min_x * 16) || engraving->pos.x >(max_x * 16))
@@ -1529,20 +1649,7 @@ static command_result GetBlockList(color_ostream &stream, const BlockRequest *in
         if (!isEngravingNew(i))
             continue;
 
-        df::art_image_chunk * chunk = NULL;
-        GET_ART_IMAGE_CHUNK GetArtImageChunk = reinterpret_cast<GET_ART_IMAGE_CHUNK>(Core::getInstance().vinfo->getAddress("get_art_image_chunk"));
-        if (GetArtImageChunk)
-        {
-            chunk = GetArtImageChunk(&(world->art_image_chunks), engraving->art_id);
-        }
-        else
-        {
-            for (size_t i = 0; i < world->art_image_chunks.size(); i++)
-            {
-                if (world->art_image_chunks[i]->id == engraving->art_id)
-                    chunk = world->art_image_chunks[i];
-            }
-        }
+        df::art_image_chunk * chunk = FindArtImageChunk(engraving->art_id);
         if (!chunk)
         {
             engravingIsNotNew(i);
@@ -1669,19 +1776,181 @@ void GetWounds(df::unit_wound * wound, UnitWound * send_wound)
     send_wound->set_severed_part(wound->flags.bits.severed_part);
 }
 
+// Unit fields that are expensive to compute but rarely change.
+// They are only rebuilt when their inputs change, and each rebuild gets a new stamp,
+// so clients that already have the current stamp for a unit aren't sent them again.
+struct UnitDetails
+{
+    uint32_t inputs_hash = 0;
+    int32_t stamp = 0;
+    bool has_name = false;
+    std::string name;
+    UnitAppearance appearance;
+    std::vector<std::string> noble_positions;
+};
+
+static std::unordered_map<int32_t, UnitDetails> unit_details;
+static int32_t unit_details_next_stamp = 0;
+
+static uint32_t HashBytes(uint32_t hash, const void * data, size_t size)
+{
+    auto bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+template<typename T>
+static uint32_t HashVector(uint32_t hash, const std::vector<T> & vec)
+{
+    size_t size = vec.size();
+    hash = HashBytes(hash, &size, sizeof(size));
+    if (size > 0)
+        hash = HashBytes(hash, vec.data(), size * sizeof(T));
+    return hash;
+}
+
+static uint32_t HashString(uint32_t hash, const std::string & str)
+{
+    size_t size = str.size();
+    hash = HashBytes(hash, &size, sizeof(size));
+    return HashBytes(hash, str.data(), size);
+}
+
+static void CopyUnitAppearance(df::unit * unit, UnitAppearance * appearance)
+{
+    for (size_t j = 0; j < unit->appearance.body_modifiers.size(); j++)
+        appearance->add_body_modifiers(unit->appearance.body_modifiers[j]);
+    for (size_t j = 0; j < unit->appearance.bp_modifiers.size(); j++)
+        appearance->add_bp_modifiers(unit->appearance.bp_modifiers[j]);
+    for (size_t j = 0; j < unit->appearance.colors.size(); j++)
+        appearance->add_colors(unit->appearance.colors[j]);
+    appearance->set_size_modifier(unit->appearance.size_modifier);
+
+    appearance->set_physical_description(Units::getPhysicalDescription(unit));
+
+    auto creatureRaw = world->raws.creatures.all[unit->race];
+    auto casteRaw = creatureRaw->caste[unit->caste];
+
+    for (size_t j = 0; j < unit->appearance.tissue_style_type.size(); j++)
+    {
+        auto type = unit->appearance.tissue_style_type[j];
+        if (type < 0)
+            continue;
+        int style_raw_index = binsearch_index(casteRaw->tissue_styles, &df::tissue_style_raw::id, type);
+        if (style_raw_index < 0)
+            continue;
+        auto styleRaw = casteRaw->tissue_styles[style_raw_index];
+        Hair * send_style = NULL;
+        if (styleRaw->token == "HAIR")
+            send_style = appearance->mutable_hair();
+        else if (styleRaw->token == "BEARD")
+            send_style = appearance->mutable_beard();
+        else if (styleRaw->token == "MOUSTACHE")
+            send_style = appearance->mutable_moustache();
+        else if (styleRaw->token == "SIDEBURNS")
+            send_style = appearance->mutable_sideburns();
+        if (send_style)
+        {
+            send_style->set_length(unit->appearance.tissue_length[j]);
+            send_style->set_style((HairStyle)unit->appearance.tissue_style[j]);
+        }
+    }
+}
+
+static const UnitDetails & GetUnitDetails(df::unit * unit)
+{
+    auto name = Units::getVisibleName(unit);
+    auto histfig = df::historical_figure::find(unit->hist_figure_id);
+
+    uint32_t hash = 2166136261u;
+    hash = HashBytes(hash, &unit->race, sizeof(unit->race));
+    hash = HashBytes(hash, &unit->caste, sizeof(unit->caste));
+    int age = int(Units::getAge(unit, false));
+    hash = HashBytes(hash, &age, sizeof(age));
+    hash = HashBytes(hash, &unit->name.has_name, sizeof(unit->name.has_name));
+    hash = HashString(hash, name->first_name);
+    hash = HashString(hash, name->nickname);
+    hash = HashBytes(hash, name->words, sizeof(name->words));
+    hash = HashBytes(hash, name->parts_of_speech, sizeof(name->parts_of_speech));
+    hash = HashBytes(hash, &name->language, sizeof(name->language));
+    hash = HashVector(hash, unit->appearance.body_modifiers);
+    hash = HashVector(hash, unit->appearance.bp_modifiers);
+    hash = HashVector(hash, unit->appearance.colors);
+    hash = HashVector(hash, unit->appearance.tissue_style);
+    hash = HashVector(hash, unit->appearance.tissue_style_type);
+    hash = HashVector(hash, unit->appearance.tissue_length);
+    hash = HashBytes(hash, &unit->appearance.size_modifier, sizeof(unit->appearance.size_modifier));
+    if (histfig)
+        hash = HashVector(hash, histfig->entity_links);
+
+    UnitDetails & details = unit_details[unit->id];
+    if (details.stamp != 0 && details.inputs_hash == hash)
+        return details;
+
+    details.inputs_hash = hash;
+    if (unit_details_next_stamp == 0)
+        unit_details_next_stamp = int32_t(time(NULL) & 0x7FFFFFFF);
+    details.stamp = unit_details_next_stamp++;
+    if (unit_details_next_stamp <= 0)
+        unit_details_next_stamp = 1;
+
+    details.has_name = unit->name.has_name;
+    details.name.clear();
+    if (details.has_name)
+        details.name = DF2UTF(Translation::TranslateName(name));
+
+    details.appearance.Clear();
+    CopyUnitAppearance(unit, &details.appearance);
+
+    details.noble_positions.clear();
+    std::vector<Units::NoblePosition> pvec;
+    if (Units::getNoblePositions(&pvec, unit))
+    {
+        for (size_t j = 0; j < pvec.size(); j++)
+            details.noble_positions.push_back(pvec[j].position->code);
+    }
+    return details;
+}
+
+static void PruneUnitDetails()
+{
+    auto & active = df::global::world->units.active;
+    if (unit_details.size() <= active.size() * 2 + 64)
+        return;
+    std::unordered_set<int32_t> alive;
+    for (size_t i = 0; i < active.size(); i++)
+        alive.insert(active[i]->id);
+    for (auto it = unit_details.begin(); it != unit_details.end();)
+    {
+        if (alive.count(it->first))
+            ++it;
+        else
+            it = unit_details.erase(it);
+    }
+}
+
 static command_result GetUnitListInside(color_ostream &stream, const BlockRequest *in, UnitList *out)
 {
     auto world = df::global::world;
+
+    std::unordered_map<int32_t, int32_t> known_stamps;
+    if (in != NULL)
+    {
+        int known_count = std::min(in->known_unit_ids_size(), in->known_unit_stamps_size());
+        for (int i = 0; i < known_count; i++)
+            known_stamps[in->known_unit_ids(i)] = in->known_unit_stamps(i);
+    }
+
+    // Built the first time a flying unit is found, rather than walking proj_list for every one.
+    std::unordered_map<df::unit *, df::proj_unitst *> unit_projectiles;
+    bool projectiles_mapped = false;
+
+    PruneUnitDetails();
+
     for (size_t i = 0; i < world->units.active.size(); i++)
     {
         df::unit * unit = world->units.active[i];
-        auto send_unit = out->add_creature_list();
-        send_unit->set_id(unit->id);
-        send_unit->set_pos_x(unit->pos.x);
-        send_unit->set_pos_y(unit->pos.y);
-        send_unit->set_pos_z(unit->pos.z);
-        send_unit->mutable_race()->set_mat_type(unit->race);
-        send_unit->mutable_race()->set_mat_index(unit->caste);
         if (in != NULL)
         {
             if (unit->pos.z < in->min_z() || unit->pos.z >= in->max_z())
@@ -1691,9 +1960,13 @@ static command_result GetUnitListInside(color_ostream &stream, const BlockReques
             if (unit->pos.y < in->min_y() * 16 || unit->pos.y >= in->max_y() * 16)
                 continue;
         }
-
-        using df::global::cur_year;
-        using df::global::cur_year_tick;
+        auto send_unit = out->add_creature_list();
+        send_unit->set_id(unit->id);
+        send_unit->set_pos_x(unit->pos.x);
+        send_unit->set_pos_y(unit->pos.y);
+        send_unit->set_pos_z(unit->pos.z);
+        send_unit->mutable_race()->set_mat_type(unit->race);
+        send_unit->mutable_race()->set_mat_index(unit->caste);
 
         send_unit->set_age(Units::getAge(unit, false));
 
@@ -1709,73 +1982,23 @@ static command_result GetUnitListInside(color_ostream &stream, const BlockReques
         size_info->set_area_base(unit->body.size_info.area_base);
         size_info->set_length_cur(unit->body.size_info.length_cur);
         size_info->set_length_base(unit->body.size_info.length_base);
-        if (unit->name.has_name)
+
+        const UnitDetails & details = GetUnitDetails(unit);
+        send_unit->set_details_stamp(details.stamp);
+        auto known = known_stamps.find(unit->id);
+        if (known == known_stamps.end() || known->second != details.stamp)
         {
-            send_unit->set_name(DF2UTF(Translation::TranslateName(Units::getVisibleName(unit))));
+            if (details.has_name)
+                send_unit->set_name(details.name);
+            send_unit->mutable_appearance()->CopyFrom(details.appearance);
+            for (size_t j = 0; j < details.noble_positions.size(); j++)
+                send_unit->add_noble_positions(details.noble_positions[j]);
         }
 
-        auto appearance = send_unit->mutable_appearance();
-        for (size_t j = 0; j < unit->appearance.body_modifiers.size(); j++)
-            appearance->add_body_modifiers(unit->appearance.body_modifiers[j]);
-        for (size_t j = 0; j < unit->appearance.bp_modifiers.size(); j++)
-            appearance->add_bp_modifiers(unit->appearance.bp_modifiers[j]);
-        for (size_t j = 0; j < unit->appearance.colors.size(); j++)
-            appearance->add_colors(unit->appearance.colors[j]);
-        appearance->set_size_modifier(unit->appearance.size_modifier);
-
-        appearance->set_physical_description(Units::getPhysicalDescription(unit));
-
         send_unit->set_profession_id(unit->profession);
 
-        std::vector<Units::NoblePosition> pvec;
-
-        if (Units::getNoblePositions(&pvec, unit))
-        {
-            for (size_t j = 0; j < pvec.size(); j++)
-            {
-                auto noble_positon = pvec[j];
-                send_unit->add_noble_positions(noble_positon.position->code);
-            }
-        }
-
         send_unit->set_rider_id(unit->relationship_ids[df::unit_relationship_type::RiderMount]);
 
-        auto creatureRaw = world->raws.creatures.all[unit->race];
-        auto casteRaw = creatureRaw->caste[unit->caste];
-
-        for (size_t j = 0; j < unit->appearance.tissue_style_type.size(); j++)
-        {
-            auto type = unit->appearance.tissue_style_type[j];
-            if (type < 0)
-                continue;
-            int style_raw_index = binsearch_index(casteRaw->tissue_styles, &df::tissue_style_raw::id, type);
-            auto styleRaw = casteRaw->tissue_styles[style_raw_index];
-            if (styleRaw->token == "HAIR")
-            {
-                auto send_style = appearance->mutable_hair();
-                send_style->set_length(unit->appearance.tissue_length[j]);
-                send_style->set_style((HairStyle)unit->appearance.tissue_style[j]);
-            }
-            else if (styleRaw->token == "BEARD")
-            {
-                auto send_style = appearance->mutable_beard();
-                send_style->set_length(unit->appearance.tissue_length[j]);
-                send_style->set_style((HairStyle)unit->appearance.tissue_style[j]);
-            }
-            else if (styleRaw->token == "MOUSTACHE")
-            {
-                auto send_style = appearance->mutable_moustache();
-                send_style->set_length(unit->appearance.tissue_length[j]);
-                send_style->set_style((HairStyle)unit->appearance.tissue_style[j]);
-            }
-            else if (styleRaw->token == "SIDEBURNS")
-            {
-                auto send_style = appearance->mutable_sideburns();
-                send_style->set_length(unit->appearance.tissue_length[j]);
-                send_style->set_style((HairStyle)unit->appearance.tissue_style[j]);
-            }
-        }
-
         for (size_t j = 0; j < unit->inventory.size(); j++)
         {
             auto inventory_item = unit->inventory[j];
@@ -1787,13 +2010,20 @@ static command_result GetUnitListInside(color_ostream &stream, const BlockReques
 
         if (unit->flags1.bits.projectile)
         {
-            for (auto proj = world->proj_list.next; proj != NULL; proj = proj->next)
+            if (!projectiles_mapped)
             {
-                STRICT_VIRTUAL_CAST_VAR(item, df::proj_unitst, proj->item);
-                if (item == NULL)
-                    continue;
-                if (item->unit != unit)
-                    continue;
+                for (auto proj = world->proj_list.next; proj != NULL; proj = proj->next)
+                {
+                    STRICT_VIRTUAL_CAST_VAR(item, df::proj_unitst, proj->item);
+                    if (item != NULL && !unit_projectiles.count(item->unit))
+                        unit_projectiles[item->unit] = item;
+                }
+                projectiles_mapped = true;
+            }
+            auto found = unit_projectiles.find(unit);
+            if (found != unit_projectiles.end())
+            {
+                auto item = found->second;
                 send_unit->set_subpos_x(item->pos_x / 100000.0);
                 send_unit->set_subpos_y(item->pos_y / 100000.0);
                 send_unit->set_subpos_z(item->pos_z / 140000.0);
@@ -1801,7 +2031,6 @@ static command_result GetUnitListInside(color_ostream &stream, const BlockReques
                 facing->set_x(item->speed_x);
                 facing->set_y(item->speed_x);
                 facing->set_z(item->speed_x);
-                break;
             }
         }
         else
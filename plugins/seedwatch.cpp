@@ -1,5 +1,6 @@
 // With thanks to peterix for DFHack and Quietust for information http://www.bay12forums.com/smf/index.php?topic=91166.msg2605147#msg2605147
 
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
@@ -29,6 +30,32 @@ const int buffer = 20; // seed number buffer - 20 is reasonable
 // abbreviations for the standard plants
 map<string, string> abbreviations;
 
+// Seed counts are kept between runs and only adjusted for the seeds that
+// appeared, disappeared or changed flags since the last one. seeds mirrors
+// items.other[SEEDS] in item id order.
+struct seed_entry
+{
+    int32_t id;
+    t_materialIndex material;
+    bool counted;
+};
+static vector<seed_entry> seeds;
+static vector<int> seedCounts; // by plant raw index
+static vector<t_materialIndex> changedMaterials;
+static vector<bool> materialChanged;
+static map<t_materialIndex, unsigned int> lastWatchMap;
+static size_t lastKitchenSize = size_t(-1); // forces evaluating every watched plant
+
+static void resetSeedCounts()
+{
+    seeds.clear();
+    seedCounts.clear();
+    changedMaterials.clear();
+    materialChanged.clear();
+    lastWatchMap.clear();
+    lastKitchenSize = size_t(-1);
+}
+
 bool ignoreSeeds(df::item_flags& f) // seeds with the following flags should not be counted
 {
     return
@@ -44,6 +71,85 @@ bool ignoreSeeds(df::item_flags& f) // seeds with the following flags should not
         f.bits.in_job;
 };
 
+static void adjustSeedCount(t_materialIndex material, int delta)
+{
+    if (material < 0 || size_t(material) >= seedCounts.size())
+        return;
+
+    seedCounts[material] += delta;
+    if (!materialChanged[material])
+    {
+        materialChanged[material] = true;
+        changedMaterials.push_back(material);
+    }
+}
+
+static bool seedIdLess(df::item *a, df::item *b)
+{
+    return a->id < b->id;
+}
+
+// brings seedCounts up to date with items.other[SEEDS], collecting the
+// materials whose count changed in changedMaterials
+static void updateSeedCounts()
+{
+    size_t plantCount = world->raws.plants.all.size();
+    if (seedCounts.size() != plantCount)
+    {
+        seeds.clear();
+        seedCounts.assign(plantCount, 0);
+        materialChanged.assign(plantCount, false);
+    }
+
+    auto *current = &world->items.other[items_other_id::SEEDS];
+    vector<df::item*> sorted;
+    if (!std::is_sorted(current->begin(), current->end(), seedIdLess))
+    {
+        sorted = *current;
+        std::sort(sorted.begin(), sorted.end(), seedIdLess);
+        current = &sorted;
+    }
+
+    vector<seed_entry> updated;
+    updated.reserve(current->size());
+    size_t j = 0;
+    for (df::item *item : *current)
+    {
+        for (; j < seeds.size() && seeds[j].id < item->id; j++)
+        {
+            if (seeds[j].counted)
+                adjustSeedCount(seeds[j].material, -1);
+        }
+
+        bool counted = !ignoreSeeds(item->flags);
+        if (j < seeds.size() && seeds[j].id == item->id)
+        {
+            seed_entry entry = seeds[j++];
+            if (entry.counted != counted)
+            {
+                adjustSeedCount(entry.material, counted ? 1 : -1);
+                entry.counted = counted;
+            }
+            updated.push_back(entry);
+            continue;
+        }
+
+        seed_entry entry;
+        entry.id = item->id;
+        entry.material = item->getMaterialIndex();
+        entry.counted = counted;
+        if (counted)
+            adjustSeedCount(entry.material, 1);
+        updated.push_back(entry);
+    }
+    for (; j < seeds.size(); j++)
+    {
+        if (seeds[j].counted)
+            adjustSeedCount(seeds[j].material, -1);
+    }
+    seeds.swap(updated);
+}
+
 void printHelp(color_ostream &out) // prints help
 {
     out.print(
@@ -114,6 +220,7 @@ DFhackCExport command_result plugin_enable(color_ostream &out, bool enable)
         }
     } else {
         running = false;
+        resetSeedCounts();
         out.print("seedwatch supervision stopped.\n");
     }
 
@@ -300,6 +407,7 @@ DFhackCExport command_result plugin_onstatechange(color_ostream &out, state_chan
         if (running)
             out.print("seedwatch deactivated due to game unload\n");
         running = false;
+        resetSeedCounts();
     }
 
     return CR_OK;
@@ -326,29 +434,42 @@ DFhackCExport command_result plugin_onupdate(color_ostream &out)
             return CR_OK;
         }
         // this is dwarf mode, continue
-        map<t_materialIndex, unsigned int> seedCount; // the number of seeds
-
-        // count all seeds and plants by RAW material
-        for(size_t i = 0; i < world->items.other[items_other_id::SEEDS].size(); ++i)
-        {
-            df::item * item = world->items.other[items_other_id::SEEDS][i];
-            t_materialIndex materialIndex = item->getMaterialIndex();
-            if(!ignoreSeeds(item->flags)) ++seedCount[materialIndex];
-        }
+        updateSeedCounts();
 
+        // Only plants whose seed count or limit changed need another look,
+        // unless something else edited the exclusion list since the last run.
         map<t_materialIndex, unsigned int> watchMap;
         Kitchen::fillWatchMap(watchMap);
+        bool checkAll = Kitchen::size() != lastKitchenSize;
+
+        vector<t_materialIndex> deny, allow;
         for(auto i = watchMap.begin(); i != watchMap.end(); ++i)
         {
-            if(seedCount[i->first] <= i->second)
+            if (i->first < 0 || size_t(i->first) >= seedCounts.size())
+                continue;
+            auto last = lastWatchMap.find(i->first);
+            if (!checkAll && !materialChanged[i->first] &&
+                last != lastWatchMap.end() && last->second == i->second)
+                continue;
+
+            unsigned int count = std::max(seedCounts[i->first], 0);
+            if(count <= i->second)
             {
-                Kitchen::denyPlantSeedCookery(i->first);
+                deny.push_back(i->first);
             }
-            else if(i->second + buffer < seedCount[i->first])
+            else if(i->second + buffer < count)
             {
-                Kitchen::allowPlantSeedCookery(i->first);
+                allow.push_back(i->first);
             }
         }
+        Kitchen::denyPlantSeedCookery(deny);
+        Kitchen::allowPlantSeedCookery(allow);
+
+        for (auto material : changedMaterials)
+            materialChanged[material] = false;
+        changedMaterials.clear();
+        lastWatchMap.swap(watchMap);
+        lastKitchenSize = Kitchen::size();
     }
     return CR_OK;
 }
@@ -23,6 +23,8 @@
 #include "df/ui.h"
 #include "df/world.h"
 
+#include "modules/Items.h"
+#include "modules/Job.h"
 #include "modules/Maps.h"
 #include "modules/Units.h"
 #include "modules/Translation.h"
@@ -87,15 +89,6 @@ void do_scan(color_ostream& out)
 
     map<tuple<df::job_type, int, int>, int> orders;  // key is item type, item subtype, size
 
-    df::item_flags bad_flags;
-    bad_flags.whole = 0;
-
-#define F(x) bad_flags.bits.x = true;
-    F(dump); F(forbid); F(garbage_collect);
-    F(hostile); F(on_fire); F(rotten); F(trader);
-    F(in_building); F(construction); F(owned);
-#undef F
-
     available.empty();
     needed.empty();
     queued.empty();
@@ -105,22 +98,28 @@ void do_scan(color_ostream& out)
 
     // scan for useable clothing
 
-    for (auto i : world->items.other[df::items_other_id::ANY_GENERIC37]) // GENERIC37 is "clothing"
+    std::vector<ClothingCount> clothing;
+    Items::getUnownedClothing(&clothing);
+    for (auto& c : clothing)
     {
-        if (i->flags.whole & bad_flags.whole)
-            continue;
-        if (i->flags.bits.owned)
+        if (c.available == 0 || c.maker_race < 0)
             continue;
-        if (i->getWear() >= 1)
-            continue;
-        df::item_type t = i->getType();
-        int size = world->raws.creatures.all[i->getMakerRace()]->adultsize;
+        int size = world->raws.creatures.all[c.maker_race]->adultsize;
 
-        available[make_pair(t, size)] += 1;
+        available[make_pair(c.type, size)] += c.available;
     }
 
     // scan for clothing raw materials
 
+    df::item_flags bad_flags;
+    bad_flags.whole = 0;
+
+#define F(x) bad_flags.bits.x = true;
+    F(dump); F(forbid); F(garbage_collect);
+    F(hostile); F(on_fire); F(rotten); F(trader);
+    F(in_building); F(construction); F(owned);
+#undef F
+
     for (auto i : world->items.other[df::items_other_id::CLOTH])
     {
         if (i->flags.whole & bad_flags.whole)
@@ -270,8 +269,11 @@ void do_scan(color_ostream& out)
 
     // scan orders
 
-    for (auto o : world->manager_orders)
+    std::vector<std::pair<df::manager_order*, int> > orderGroups;
+    Job::getOrderGroups(&orderGroups, Job::ORDER_JOB_TYPE | Job::ORDER_ITEM_SUBTYPE | Job::ORDER_HIST_FIGURE);
+    for (auto g : orderGroups)
     {
+        auto o = g.first;
         auto f = jobTypeMap.find(o->job_type);
         if (f == jobTypeMap.end())
             continue;
@@ -283,7 +285,7 @@ void do_scan(color_ostream& out)
 
         int size = world->raws.creatures.all[race]->adultsize;
 
-        orders[make_tuple(o->job_type, sub, size)] -= o->amount_left;
+        orders[make_tuple(o->job_type, sub, size)] -= g.second;
     }
 
     // place orders
@@ -27,28 +27,30 @@ struct kitchen_prefs_all_hook : df::viewscreen_kitchenprefst {
         if (flag.whole && size_t(cursor) < forbidden[page].size())
         {
             bool was_forbidden = forbidden[page][cursor].whole & flag.whole;
+            std::vector<Kitchen::Exclusion> exclusions;
             for (size_t i = 0; i < forbidden[page].size(); i++)
             {
                 if (possible[page][i].whole & flag.whole)
                 {
                     if (was_forbidden)
-                    {
-                        // unset flag
-                        forbidden[page][i].whole &= ~flag.whole;
-                        Kitchen::removeExclusion(exc_type,
-                            item_type[page][i], item_subtype[page][i],
-                            mat_type[page][i], mat_index[page][i]);
-                    }
+                        forbidden[page][i].whole &= ~flag.whole; // unset flag
                     else
-                    {
-                        // set flag
-                        forbidden[page][i].whole |= flag.whole;
-                        Kitchen::addExclusion(exc_type,
-                            item_type[page][i], item_subtype[page][i],
-                            mat_type[page][i], mat_index[page][i]);
-                    }
+                        forbidden[page][i].whole |= flag.whole; // set flag
+
+                    Kitchen::Exclusion e;
+                    e.type = exc_type;
+                    e.item_type = item_type[page][i];
+                    e.item_subtype = item_subtype[page][i];
+                    e.mat_type = mat_type[page][i];
+                    e.mat_index = mat_index[page][i];
+                    exclusions.push_back(e);
                 }
             }
+
+            if (was_forbidden)
+                Kitchen::removeExclusions(exclusions);
+            else
+                Kitchen::addExclusions(exclusions);
         }
         INTERPOSE_NEXT(feed)(input);
     }
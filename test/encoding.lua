@@ -6,3 +6,38 @@ function test.toSearchNormalized()
     expect.eq(dfhack.toSearchNormalized(dfhack.utf2df('ÄÇÉÖÜÿ')), 'aceouy')
     expect.eq(dfhack.toSearchNormalized(dfhack.utf2df('æÆ')), 'aeae')
 end
+
+function test.df2utf_utf2df_roundtrip()
+    local all = {}
+    for i = 0, 255 do
+        table.insert(all, string.char(i))
+    end
+    all = table.concat(all)
+    expect.eq(dfhack.utf2df(dfhack.df2utf(all)), all)
+    expect.eq(dfhack.df2utf('plain text'), 'plain text')
+    expect.eq(dfhack.df2utf('\x01\x7f'), '☺⌂')
+    expect.eq(dfhack.utf2df('ünmappable ☃'), dfhack.utf2df('ü') .. 'nmappable ?')
+    expect.eq(dfhack.utf2df('broken \xe2\x98 sequence'), 'broken ? sequence')
+end
+
+function test.transcoding_throughput()
+    local text = ('Urist McMiner, ' .. dfhack.utf2df('Ùst Kùlet') .. ' the dwarf. '):rep(64 * 1024)
+    local utf = dfhack.df2utf(text)
+
+    local start = os.clock()
+    for _ = 1, 10 do
+        dfhack.df2utf(text)
+    end
+    local df2utf_time = os.clock() - start
+
+    start = os.clock()
+    for _ = 1, 10 do
+        dfhack.utf2df(utf)
+    end
+    local utf2df_time = os.clock() - start
+
+    local mb = #text * 10 / (1024 * 1024)
+    print(('df2utf: %.1f MB/s, utf2df: %.1f MB/s'):format(
+        mb / math.max(df2utf_time, 1e-6), mb / math.max(utf2df_time, 1e-6)))
+    expect.eq(dfhack.utf2df(utf), text)
+end
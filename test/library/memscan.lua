@@ -0,0 +1,80 @@
+local memscan = require('memscan')
+
+local function with_area(size, fn)
+    return dfhack.with_temp_object(df.new('uint8_t', size), function(buf)
+        local _, addr = df.sizeof(buf)
+        return fn(memscan.MemoryArea.new(addr, addr + size))
+    end)
+end
+
+-- Reference implementation of CheckedArray:find_all
+local function naive_find_all(arr, data, sidx, eidx, reverse)
+    local rv = {}
+    for i = sidx, eidx - #data do
+        local ok = true
+        for j = 1, #data do
+            if arr[i+j-1] ~= data[j] then
+                ok = false
+                break
+            end
+        end
+        if ok then
+            table.insert(rv, reverse and 1 or #rv+1, i)
+        end
+    end
+    return rv
+end
+
+function test.find_all()
+    with_area(1024, function(area)
+        local bytes = area.uint8_t
+        for i = 0, #bytes-1 do
+            bytes[i] = (i * 7) % 3
+        end
+        for _, tname in ipairs{'uint8_t', 'uint16_t', 'int32_t'} do
+            local arr = area[tname]
+            for _, data in ipairs{{arr[5]}, {arr[10], arr[11]}, {arr[3], arr[4], arr[5]}} do
+                for _, reverse in ipairs{false, true} do
+                    local expected = naive_find_all(arr, data, 2, #arr - 1, reverse)
+                    expect.table_eq(arr:find_all(data, 2, #arr - 1, reverse), expected,
+                                    ('%s reverse=%s'):format(tname, reverse))
+                    expect.eq(arr:find(data, 2, #arr - 1, reverse), expected[1])
+                end
+            end
+        end
+        expect.nil_(bytes:find_one{bytes[5]})
+        bytes[1000] = 77
+        expect.eq(bytes:find_one{77}, 1000)
+        expect.eq(bytes:find_one({77}, 0, 1000), nil)
+    end)
+end
+
+function test.list_and_filter_changes()
+    with_area(4096, function(area)
+        local saved = area:clone()
+        local new_arr, old_arr = area.uint16_t, saved.uint16_t
+        for i = 0, #new_arr-1 do
+            new_arr[i] = i % 5
+        end
+        saved:copy_from(area)
+        for i = 0, #new_arr-1, 3 do
+            new_arr[i] = new_arr[i] + (i % 2 == 0 and 1 or 2)
+        end
+
+        local all = new_arr:list_changes(old_arr)
+        expect.eq(#all, math.ceil(#new_arr / 3))
+        expect.eq(all[2], 3)
+
+        local plus_one = new_arr:list_changes(old_arr, nil, nil, 1)
+        for _, idx in ipairs(plus_one) do
+            expect.eq(idx % 2, 0)
+        end
+        expect.table_eq(new_arr:filter_changes(all, old_arr, nil, nil, 1), plus_one)
+        expect.table_eq(new_arr:filter_changes(all, old_arr, 0), new_arr:list_changes(old_arr, 0))
+        expect.nil_(new_arr:filter_changes({1, 2}, old_arr))
+        expect.error_match('out of bounds', function()
+            new_arr:filter_changes({#new_arr}, old_arr)
+        end)
+        saved:delete()
+    end)
+end
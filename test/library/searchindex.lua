@@ -0,0 +1,36 @@
+function test.filter()
+    local index = dfhack.searchindex.new{'Iron bars', 'pig iron', 'ironwood', 'bar of soap', 'Fire clay', 42}
+    expect.eq(index:size(), 6)
+    expect.table_eq(index:filter('iron'), {1, 2, 3})
+    expect.table_eq(index:filter('iron ba'), {1})
+    expect.table_eq(index:filter('ba'), {1, 4})
+    expect.table_eq(index:filter('ar'), {})
+    expect.table_eq(index:filter(''), {1, 2, 3, 4, 5, 6})
+    expect.table_eq(index:filter('  clay  '), {5})
+end
+
+function test.filter_pos()
+    local index = dfhack.searchindex.new{'a', 'ab', 'b', 'abc'}
+    local result, pos = index:filter('ab', 4)
+    expect.table_eq(result, {2, 4})
+    expect.eq(pos, 2)
+    result, pos = index:filter('ab', 3)
+    expect.nil_(pos)
+end
+
+function test.filter_normalized()
+    local index = dfhack.searchindex.new{dfhack.utf2df('Ùst Kùlet'), 'stone-crafter'}
+    expect.table_eq(index:filter('kul'), {1})
+    expect.table_eq(index:filter(dfhack.utf2df('ÙST')), {1})
+    expect.table_eq(index:filter('crafter'), {2})
+    expect.table_eq(index:filter('-craft'), {})
+end
+
+function test.filter_narrowing()
+    local index = dfhack.searchindex.new{'granite', 'gabbro', 'green glass', 'gneiss'}
+    expect.table_eq(index:filter('g'), {1, 2, 3, 4})
+    expect.table_eq(index:filter('gr'), {1, 3})
+    expect.table_eq(index:filter('gr gl'), {3})
+    -- going back to a shorter filter searches everything again
+    expect.table_eq(index:filter('ga'), {2})
+end
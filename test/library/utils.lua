@@ -144,3 +144,76 @@ function test.processArgsGetopt_parsing_errors()
                        end,
                        'fail to pass value to long param that requires one')
 end
+
+local function with_entity_links(ids, fn)
+    local hf = df.new(df.historical_figure)
+    for _,id in ipairs(ids) do
+        local link = df.new(df.histfig_entity_link_memberst)
+        link.entity_id = id
+        hf.entity_links:insert('#', link)
+    end
+    dfhack.with_finalize(
+        function()
+            for _,link in ipairs(hf.entity_links) do
+                link:delete()
+            end
+            hf:delete()
+        end,
+        fn, hf.entity_links)
+end
+
+local function field_values(vector, field)
+    local values = {}
+    for _,obj in ipairs(vector) do
+        table.insert(values, obj[field])
+    end
+    return values
+end
+
+function test.sorted_vector_by_field()
+    with_entity_links({30, 10, 20, 10}, function(links)
+        local first_ten = links[1]
+        utils.sort_vector(links, 'entity_id')
+        expect.table_eq(field_values(links, 'entity_id'), {10, 10, 20, 30})
+        expect.eq(links[0], first_ten, 'sort is stable')
+
+        local item, found, pos = utils.binsearch(links, 20, 'entity_id')
+        expect.true_(found)
+        expect.eq(pos, 2)
+        expect.eq(item, links[2])
+        item, found, pos = utils.binsearch(links, 25, 'entity_id')
+        expect.nil_(item)
+        expect.false_(found)
+        expect.eq(pos, 3)
+
+        expect.eq(utils.linear_index(links, 30, 'entity_id'), 3)
+        expect.eq(utils.linear_index(links, links[2]), 2)
+        expect.nil_(utils.linear_index(links, 40, 'entity_id'))
+
+        local did_erase = utils.erase_sorted_key(links, 20, 'entity_id')
+        expect.true_(did_erase)
+        expect.table_eq(field_values(links, 'entity_id'), {10, 10, 30})
+        expect.false_(utils.erase_sorted_key(links, 20, 'entity_id'))
+
+        utils.sort_vector(links, 'entity_id', function(a, b) return utils.compare(b, a) end)
+        expect.table_eq(field_values(links, 'entity_id'), {30, 10, 10})
+    end)
+end
+
+function test.sorted_vector_of_integers()
+    local path = df.new(df.coord_path)
+    dfhack.with_finalize(function() path:delete() end, function()
+        for _,v in ipairs{5, -3, 12, 0} do
+            path.x:insert('#', v)
+        end
+        utils.sort_vector(path.x)
+        expect.table_eq({path.x[0], path.x[1], path.x[2], path.x[3]}, {-3, 0, 5, 12})
+
+        expect.true_(utils.insert_sorted(path.x, 7))
+        expect.false_(utils.insert_sorted(path.x, 7))
+        local _, found, pos = utils.binsearch(path.x, 7)
+        expect.true_(found)
+        expect.eq(pos, 3)
+        expect.eq(utils.linear_index(path.x, 12), 4)
+    end)
+end